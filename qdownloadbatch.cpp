@@ -0,0 +1,681 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2020 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "qdownloadbatch.h"
+#include "qdownloadpostprocessor.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMetaEnum>
+#include <QPair>
+#include <QSaveFile>
+#include <QXmlStreamReader>
+#include <algorithm>
+
+namespace {
+
+QString originKey(const QUrl &url)
+{
+    const QString scheme = url.scheme().toLower();
+    const int defaultPort = (scheme == QString::fromUtf8("https")) ? 443 : 80;
+    return QString::fromUtf8("%1://%2:%3")
+        .arg(scheme, url.host().toLower(), QString::number(url.port(defaultPort)));
+}
+
+QString entryKey(const QDownloadBatch::Entry &entry)
+{
+    if (!entry.name.isEmpty()) {
+        return entry.name;
+    }
+    return entry.urls.isEmpty() ? QString{} : entry.urls.constFirst().toString();
+}
+
+// Manifests are not trusted: a name must stay inside the save directory, so
+// it can be neither absolute nor contain ".." segments (RFC 5854 4.1.2.1).
+bool isSafeName(const QString &name)
+{
+    // Treat backslashes as separators on all platforms.
+    QString path = name;
+    path.replace(QChar::fromLatin1('\\'), QChar::fromLatin1('/'));
+    if (path.startsWith(QChar::fromLatin1('/')) || QDir::isAbsolutePath(path)
+        || ((path.size() > 1) && path.at(0).isLetter() && (path.at(1) == QChar::fromLatin1(':')))) {
+        return false;
+    }
+    const QStringList segments = path.split(QChar::fromLatin1('/'));
+    return !segments.contains(QString::fromUtf8(".."));
+}
+
+// Resolves the directory of an entry, or returns an empty string if it would
+// leave the save directory.
+QString entryDirectory(const QString &saveDirectory, const QString &name)
+{
+    if (!isSafeName(name)) {
+        return {};
+    }
+    const QString base = QDir::cleanPath(QDir(saveDirectory).absolutePath());
+    const QString directory = QDir::cleanPath(QDir(base).filePath(QFileInfo(name).path()));
+    if ((directory != base) && !directory.startsWith(base + QChar::fromLatin1('/'))) {
+        return {};
+    }
+    return directory;
+}
+
+QList<QDownloadBatch::Entry> parseJsonManifest(const QByteArray &data, bool *ok)
+{
+    QJsonParseError error = {};
+    const QJsonDocument document = QJsonDocument::fromJson(data, &error);
+    if (error.error != QJsonParseError::NoError) {
+        qDebug() << "Failed to parse the JSON manifest:" << error.errorString();
+        *ok = false;
+        return {};
+    }
+    const QJsonArray files = document.isArray()
+                                 ? document.array()
+                                 : document.object().value(QString::fromUtf8("files")).toArray();
+    QList<QDownloadBatch::Entry> entries = {};
+    for (auto &&file : qAsConst(files)) {
+        const QJsonObject object = file.toObject();
+        QDownloadBatch::Entry entry = {};
+        entry.name = object.value(QString::fromUtf8("name")).toString();
+        const QUrl url(object.value(QString::fromUtf8("url")).toString());
+        if (url.isValid()) {
+            entry.urls.append(url);
+        }
+        const QJsonArray mirrors = object.value(QString::fromUtf8("mirrors")).toArray();
+        for (auto &&mirror : qAsConst(mirrors)) {
+            const QUrl mirrorUrl(mirror.toString());
+            if (mirrorUrl.isValid()) {
+                entry.urls.append(mirrorUrl);
+            }
+        }
+        entry.size = qint64(object.value(QString::fromUtf8("size")).toDouble());
+        entry.sha256 = QByteArray::fromHex(
+            object.value(QString::fromUtf8("sha256")).toString().toLatin1());
+        if (entry.urls.isEmpty()) {
+            qDebug() << "Ignoring manifest entry without any valid URL:" << entry.name;
+            continue;
+        }
+        if (!isSafeName(entry.name)) {
+            qDebug() << "Ignoring manifest entry with an unsafe name:" << entry.name;
+            continue;
+        }
+        entries.append(entry);
+    }
+    *ok = true;
+    return entries;
+}
+
+QList<QDownloadBatch::Entry> parseMetalinkManifest(const QByteArray &data, bool *ok)
+{
+    QList<QDownloadBatch::Entry> entries = {};
+    QDownloadBatch::Entry entry = {};
+    // Metalink URLs are ordered by their priority attribute, lower is better.
+    QList<QPair<int, QUrl>> urls = {};
+    bool inFile = false;
+    QXmlStreamReader reader(data);
+    while (!reader.atEnd()) {
+        reader.readNext();
+        if (reader.isStartElement()) {
+            const QStringRef name = reader.name();
+            if (name == QString::fromUtf8("file")) {
+                inFile = true;
+                entry = {};
+                urls.clear();
+                entry.name = reader.attributes().value(QString::fromUtf8("name")).toString();
+            } else if (inFile && (name == QString::fromUtf8("size"))) {
+                entry.size = reader.readElementText().trimmed().toLongLong();
+            } else if (inFile && (name == QString::fromUtf8("hash"))) {
+                const QString type = reader.attributes()
+                                         .value(QString::fromUtf8("type"))
+                                         .toString()
+                                         .toLower();
+                const QString hash = reader.readElementText().trimmed();
+                if ((type == QString::fromUtf8("sha-256"))
+                    || (type == QString::fromUtf8("sha256"))) {
+                    entry.sha256 = QByteArray::fromHex(hash.toLatin1());
+                }
+            } else if (inFile && (name == QString::fromUtf8("url"))) {
+                const QXmlStreamAttributes attributes = reader.attributes();
+                // Metalink 4 uses "priority", Metalink 3 uses "preference"
+                // where higher is better.
+                int priority = 999999;
+                if (attributes.hasAttribute(QString::fromUtf8("priority"))) {
+                    priority = attributes.value(QString::fromUtf8("priority")).toInt();
+                } else if (attributes.hasAttribute(QString::fromUtf8("preference"))) {
+                    priority = 100 - attributes.value(QString::fromUtf8("preference")).toInt();
+                }
+                const QUrl url(reader.readElementText().trimmed());
+                if (url.isValid()) {
+                    urls.append({priority, url});
+                }
+            }
+        } else if (reader.isEndElement() && (reader.name() == QString::fromUtf8("file"))) {
+            inFile = false;
+            std::stable_sort(urls.begin(), urls.end(), [](const auto &lhs, const auto &rhs) {
+                return lhs.first < rhs.first;
+            });
+            for (auto &&url : qAsConst(urls)) {
+                entry.urls.append(url.second);
+            }
+            if (entry.urls.isEmpty()) {
+                qDebug() << "Ignoring manifest entry without any valid URL:" << entry.name;
+                continue;
+            }
+            if (!isSafeName(entry.name)) {
+                qDebug() << "Ignoring manifest entry with an unsafe name:" << entry.name;
+                continue;
+            }
+            entries.append(entry);
+        }
+    }
+    if (reader.hasError()) {
+        qDebug() << "Failed to parse the Metalink manifest:" << reader.errorString();
+        *ok = false;
+        return {};
+    }
+    *ok = true;
+    return entries;
+}
+
+} // namespace
+
+QDownloadBatch::QDownloadBatch(QObject *parent) : QObject(parent)
+{
+    qRegisterMetaType<Entry>();
+    qRegisterMetaType<EntryResult>();
+    m_saveDirectory = QDir::toNativeSeparators(QCoreApplication::applicationDirPath());
+}
+
+QDownloadBatch::~QDownloadBatch()
+{
+    stop();
+}
+
+QList<QDownloadBatch::Entry> QDownloadBatch::loadManifest(const QString &filePath, bool *ok)
+{
+    bool _ok = false;
+    QList<Entry> entries = {};
+    QFile file(filePath);
+    if (file.open(QFile::ReadOnly)) {
+        const QByteArray data = file.readAll();
+        const QByteArray trimmed = data.trimmed();
+        if (trimmed.startsWith('{') || trimmed.startsWith('[')) {
+            entries = parseJsonManifest(data, &_ok);
+        } else {
+            entries = parseMetalinkManifest(data, &_ok);
+        }
+    } else {
+        qDebug() << "Cannot open the manifest file:" << file.errorString();
+    }
+    if (ok) {
+        *ok = _ok;
+    }
+    return entries;
+}
+
+QList<QDownloadBatch::Entry> QDownloadBatch::entries() const
+{
+    return m_entries;
+}
+
+void QDownloadBatch::setEntries(const QList<Entry> &value)
+{
+    if (m_running) {
+        qDebug() << "Stop the current batch first before changing its entries.";
+        return;
+    }
+    m_entries = value;
+    m_results.clear();
+    for (int i = 0; i != m_entries.size(); ++i) {
+        m_results.append(EntryResult{});
+    }
+}
+
+QDownloadBatch::Entry QDownloadBatch::entry(int index) const
+{
+    return m_entries.value(index);
+}
+
+QList<QDownloadBatch::EntryResult> QDownloadBatch::results() const
+{
+    return m_results;
+}
+
+QDownloadBatch::EntryResult QDownloadBatch::result(int index) const
+{
+    return m_results.value(index);
+}
+
+QString QDownloadBatch::saveDirectory() const
+{
+    return m_saveDirectory;
+}
+
+void QDownloadBatch::setSaveDirectory(const QString &value)
+{
+    if (value.isEmpty()) {
+        qDebug() << "The given path is empty.";
+        return;
+    }
+    if (m_saveDirectory != value) {
+        m_saveDirectory = QDir::toNativeSeparators(value);
+        Q_EMIT saveDirectoryChanged();
+    }
+}
+
+int QDownloadBatch::maxConnections() const
+{
+    return m_maxConnections;
+}
+
+void QDownloadBatch::setMaxConnections(int value)
+{
+    if (value < 1) {
+        qDebug() << "The minimum of connections is one.";
+        return;
+    }
+    if (m_maxConnections != value) {
+        m_maxConnections = value;
+        Q_EMIT maxConnectionsChanged();
+        scheduleNext();
+    }
+}
+
+QDownloadPostProcessor *QDownloadBatch::postProcessor() const
+{
+    return m_postProcessor;
+}
+
+void QDownloadBatch::setPostProcessor(QDownloadPostProcessor *value)
+{
+    if (m_postProcessor == value) {
+        return;
+    }
+    if (m_postProcessor) {
+        m_postProcessor->disconnect(this);
+    }
+    m_postProcessor = value;
+    if (m_postProcessor) {
+        connect(m_postProcessor,
+                &QDownloadPostProcessor::saturatedChanged,
+                this,
+                &QDownloadBatch::scheduleNext);
+    }
+}
+
+QList<QDownloader::PostProcessHook> QDownloadBatch::postProcessHooks() const
+{
+    return m_postProcessHooks;
+}
+
+void QDownloadBatch::setPostProcessHooks(const QList<QDownloader::PostProcessHook> &value)
+{
+    m_postProcessHooks = value;
+}
+
+QString QDownloadBatch::reportFile() const
+{
+    return m_reportFile;
+}
+
+void QDownloadBatch::setReportFile(const QString &value)
+{
+    if (m_reportFile != value) {
+        m_reportFile = value;
+        Q_EMIT reportFileChanged();
+    }
+}
+
+bool QDownloadBatch::isRunning() const
+{
+    return m_running;
+}
+
+void QDownloadBatch::start()
+{
+    if (m_running) {
+        qDebug() << "The batch is already running.";
+        return;
+    }
+    setEntries(m_entries);
+    restorePreviousReport();
+    m_queue.clear();
+    for (int i = 0; i != m_entries.size(); ++i) {
+        EntryResult &entryResult = m_results[i];
+        if (entryResult.status != Status::Pending) {
+            continue;
+        }
+        // Entries given to setEntries() haven't been checked by the parsers.
+        if (entryDirectory(m_saveDirectory, m_entries.at(i).name).isEmpty()) {
+            qDebug() << "Refusing to save a file outside of the save directory:"
+                     << m_entries.at(i).name;
+            entryResult.status = Status::Failed;
+            entryResult.result.error = QDownloader::Error::InvalidArguments;
+            entryResult.result.errorString = QString::fromUtf8(
+                "The file name leaves the save directory.");
+            continue;
+        }
+        m_queue.append(i);
+    }
+    // Largest files first so that they don't become the tail of the batch,
+    // files of unknown size go last.
+    std::stable_sort(m_queue.begin(), m_queue.end(), [this](int lhs, int rhs) {
+        return m_entries.at(lhs).size > m_entries.at(rhs).size;
+    });
+    m_startTime = QDateTime::currentMSecsSinceEpoch();
+    m_elapsed = 0;
+    m_timer.start();
+    m_running = true;
+    Q_EMIT runningChanged();
+    scheduleNext();
+}
+
+void QDownloadBatch::stop()
+{
+    if (!m_running) {
+        return;
+    }
+    const QList<QDownloader *> active = m_active.keys();
+    for (auto &&downloader : qAsConst(active)) {
+        downloader->disconnect(this);
+        downloader->stop();
+        const int index = m_active.take(downloader);
+        m_results[index] = EntryResult{};
+        downloader->deleteLater();
+    }
+    m_transferring.clear();
+    qDeleteAll(m_idle);
+    m_idle.clear();
+    m_queue.clear();
+    m_running = false;
+    m_elapsed = m_timer.elapsed();
+    writeReport();
+    Q_EMIT runningChanged();
+}
+
+QDownloader *QDownloadBatch::takeDownloader()
+{
+    if (!m_idle.isEmpty()) {
+        return m_idle.takeLast();
+    }
+    const auto downloader = new QDownloader(this);
+    // Queued, so that a download failing inside startAsync() doesn't re-enter
+    // the scheduler.
+    connect(
+        downloader,
+        &QDownloader::finished,
+        this,
+        [this, downloader]() { onDownloaderFinished(downloader); },
+        Qt::QueuedConnection);
+    // The connection is free once the transfer is done, even if the file is
+    // still being post processed.
+    connect(
+        downloader,
+        &QDownloader::downloaded,
+        this,
+        [this, downloader]() {
+            m_transferring.remove(downloader);
+            scheduleNext();
+        },
+        Qt::QueuedConnection);
+    return downloader;
+}
+
+void QDownloadBatch::scheduleNext()
+{
+    if (!m_running) {
+        return;
+    }
+    while (!m_queue.isEmpty() && (m_transferring.size() < m_maxConnections)) {
+        // Back pressure: don't download more than the post processor keeps up with.
+        if (m_postProcessor && m_postProcessor->isSaturated()) {
+            break;
+        }
+        const int position = nextQueuedEntry();
+        if (position < 0) {
+            // Every queued entry waits for a busy host.
+            break;
+        }
+        startEntry(takeDownloader(), m_queue.takeAt(position));
+    }
+    if (m_queue.isEmpty() && m_active.isEmpty()) {
+        qDeleteAll(m_idle);
+        m_idle.clear();
+        m_running = false;
+        m_elapsed = m_timer.elapsed();
+        writeReport();
+        Q_EMIT runningChanged();
+        Q_EMIT finished();
+    }
+}
+
+QUrl QDownloadBatch::nextUrl(int index) const
+{
+    // Every attempt moves on to the next mirror.
+    const Entry &entry = m_entries.at(index);
+    return entry.urls.at(m_results.at(index).attempts % entry.urls.size());
+}
+
+int QDownloadBatch::nextQueuedEntry() const
+{
+    QHash<QString, int> transfers = {};
+    for (auto &&origin : qAsConst(m_transferring)) {
+        ++transfers[origin];
+    }
+    // The queue order is kept among the hosts which can take another transfer.
+    for (int i = 0; i != m_queue.size(); ++i) {
+        const QUrl url = nextUrl(m_queue.at(i));
+        if (transfers.value(originKey(url)) < QDownloader::hostCapabilities(url).maxConnections) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void QDownloadBatch::startEntry(QDownloader *downloader, int index)
+{
+    const Entry &entry = m_entries.at(index);
+    EntryResult &entryResult = m_results[index];
+    const QUrl url = nextUrl(index);
+    ++entryResult.attempts;
+    entryResult.status = Status::Running;
+    const QFileInfo nameInfo(entry.name.isEmpty() ? url.fileName() : entry.name);
+    // Checked by start() already.
+    downloader->setSaveDirectory(entryDirectory(m_saveDirectory, entry.name));
+    downloader->setUrl(url);
+    // A known size saves the HEAD request.
+    downloader->setFileInfo({nameInfo.fileName(), {}, entry.size});
+    // A mismatching file is removed by the downloader, which frees its name
+    // for the next mirror.
+    downloader->setExpectedFileSize(entry.size);
+    downloader->setExpectedDigest(entry.sha256);
+    // The downloader has verified the file before the hooks run.
+    downloader->setPostProcessor(m_postProcessor);
+    downloader->setPostProcessHooks(m_postProcessHooks);
+    m_active.insert(downloader, index);
+    m_transferring.insert(downloader, originKey(url));
+    downloader->startAsync();
+}
+
+void QDownloadBatch::onDownloaderFinished(QDownloader *downloader)
+{
+    if (!m_active.contains(downloader)) {
+        return;
+    }
+    const int index = m_active.take(downloader);
+    const Entry &entry = m_entries.at(index);
+    EntryResult &entryResult = m_results[index];
+    entryResult.result = downloader->result();
+    const QDownloader::Result &result = entryResult.result;
+    m_transferring.remove(downloader);
+    m_idle.append(downloader);
+    // Another mirror only helps if the transfer failed or the file was broken,
+    // not if e.g. a post process hook failed on a good file.
+    const bool retry = ((result.error == QDownloader::Error::NetworkError)
+                        || (result.error == QDownloader::Error::IntegrityError))
+                       && (entryResult.attempts < entry.urls.size());
+    if (retry) {
+        // Back to the front of the queue, so that the retry respects the
+        // connection budget and the back pressure of the post processor.
+        entryResult.status = Status::Pending;
+        m_queue.prepend(index);
+        scheduleNext();
+        return;
+    }
+    entryResult.status = (result.error == QDownloader::Error::NoError) ? Status::Succeeded
+                                                                        : Status::Failed;
+    writeReport();
+    Q_EMIT entryFinished(index);
+    scheduleNext();
+}
+
+QJsonObject QDownloadBatch::report() const
+{
+    const QMetaEnum statusEnum = QMetaEnum::fromType<Status>();
+    const QMetaEnum errorEnum = QMetaEnum::fromType<QDownloader::Error>();
+    QJsonArray files = {};
+    qint64 totalBytes = 0;
+    int succeeded = 0, failed = 0, skipped = 0;
+    for (int i = 0; i != m_entries.size(); ++i) {
+        const EntryResult &entryResult = m_results.at(i);
+        const QDownloader::Result &result = entryResult.result;
+        QJsonObject file = {};
+        file.insert(QString::fromUtf8("name"), entryKey(m_entries.at(i)));
+        file.insert(QString::fromUtf8("status"),
+                    QString::fromLatin1(statusEnum.valueToKey(int(entryResult.status))));
+        file.insert(QString::fromUtf8("url"), result.url.toString());
+        file.insert(QString::fromUtf8("path"), result.filePath);
+        file.insert(QString::fromUtf8("size"), result.fileSize);
+        file.insert(QString::fromUtf8("sha256"), QString::fromLatin1(result.digest.toHex()));
+        file.insert(QString::fromUtf8("error"),
+                    QString::fromLatin1(errorEnum.valueToKey(int(result.error))));
+        file.insert(QString::fromUtf8("errorString"), result.errorString);
+        file.insert(QString::fromUtf8("attempts"), entryResult.attempts);
+        file.insert(QString::fromUtf8("elapsed"), result.elapsed);
+        file.insert(QString::fromUtf8("throughput"),
+                    (result.elapsed > 0) ? (qreal(result.fileSize) * 1000.0 / result.elapsed)
+                                         : 0.0);
+        files.append(file);
+        switch (entryResult.status) {
+        case Status::Succeeded:
+            ++succeeded;
+            totalBytes += result.fileSize;
+            break;
+        case Status::Failed:
+            ++failed;
+            break;
+        case Status::Skipped:
+            ++skipped;
+            break;
+        default:
+            break;
+        }
+    }
+    const qint64 elapsed = m_running ? m_timer.elapsed() : m_elapsed;
+    QJsonObject object = {};
+    object.insert(QString::fromUtf8("startTime"), m_startTime);
+    object.insert(QString::fromUtf8("elapsed"), elapsed);
+    object.insert(QString::fromUtf8("total"), m_entries.size());
+    object.insert(QString::fromUtf8("succeeded"), succeeded);
+    object.insert(QString::fromUtf8("failed"), failed);
+    object.insert(QString::fromUtf8("skipped"), skipped);
+    object.insert(QString::fromUtf8("totalBytes"), totalBytes);
+    object.insert(QString::fromUtf8("throughput"),
+                  (elapsed > 0) ? (qreal(totalBytes) * 1000.0 / elapsed) : 0.0);
+    object.insert(QString::fromUtf8("files"), files);
+    return object;
+}
+
+void QDownloadBatch::writeReport() const
+{
+    if (m_reportFile.isEmpty()) {
+        return;
+    }
+    // Never leave a half written report behind, it's needed for resuming.
+    QSaveFile file(m_reportFile);
+    if (!file.open(QFile::WriteOnly)) {
+        qDebug() << "Cannot open the report file for writing:" << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(report()).toJson());
+    if (!file.commit()) {
+        qDebug() << "Failed to write the report file:" << file.errorString();
+    }
+}
+
+void QDownloadBatch::restorePreviousReport()
+{
+    if (m_reportFile.isEmpty()) {
+        return;
+    }
+    QFile file(m_reportFile);
+    if (!file.exists() || !file.open(QFile::ReadOnly)) {
+        return;
+    }
+    const QJsonArray files = QJsonDocument::fromJson(file.readAll())
+                                 .object()
+                                 .value(QString::fromUtf8("files"))
+                                 .toArray();
+    QHash<QString, QJsonObject> done = {};
+    for (auto &&value : qAsConst(files)) {
+        const QJsonObject object = value.toObject();
+        const QString status = object.value(QString::fromUtf8("status")).toString();
+        if ((status == QString::fromUtf8("Succeeded"))
+            || (status == QString::fromUtf8("Skipped"))) {
+            done.insert(object.value(QString::fromUtf8("name")).toString(), object);
+        }
+    }
+    for (int i = 0; i != m_entries.size(); ++i) {
+        const Entry &entry = m_entries.at(i);
+        const auto it = done.constFind(entryKey(entry));
+        if (it == done.constEnd()) {
+            continue;
+        }
+        const QJsonObject &object = it.value();
+        const QString filePath = object.value(QString::fromUtf8("path")).toString();
+        const qint64 fileSize = qint64(object.value(QString::fromUtf8("size")).toDouble());
+        const QByteArray digest = QByteArray::fromHex(
+            object.value(QString::fromUtf8("sha256")).toString().toLatin1());
+        const QFileInfo fileInfo(filePath);
+        // Only trust the report if the file is still there and intact, and if
+        // it is still the file the manifest asks for (a new release may keep
+        // the name and the size).
+        if (!fileInfo.exists() || (fileInfo.size() != fileSize)
+            || ((entry.size > 0) && (entry.size != fileSize))
+            || (!entry.sha256.isEmpty() && (entry.sha256 != digest))) {
+            continue;
+        }
+        EntryResult &entryResult = m_results[i];
+        entryResult.status = Status::Skipped;
+        entryResult.result.url = QUrl(object.value(QString::fromUtf8("url")).toString());
+        entryResult.result.filePath = filePath;
+        entryResult.result.fileSize = fileSize;
+        entryResult.result.digest = digest;
+    }
+}
@@ -0,0 +1,157 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2020 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "qdownloader.h"
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+
+#define _WWX190_DL_DEFAULT_BATCH_CONNECTIONS 4
+
+// Downloads all files of a manifest with a limited number of connections.
+//
+// Supported manifests are Metalink (RFC 5854 and the older 3.0 format) and
+// JSON documents like the following one (a top level array of files works,
+// too; "name", "mirrors", "size" and "sha256" are optional):
+//
+// {
+//     "files": [
+//         {
+//             "name": "example.tar.gz",
+//             "url": "https://example.com/example.tar.gz",
+//             "mirrors": ["https://mirror.example.com/example.tar.gz"],
+//             "size": 1048576,
+//             "sha256": "e3b0c44298fc1c149afbf4c8996fb924..."
+//         }
+//     ]
+// }
+class QDOWNLOADER_EXPORT QDownloadBatch : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(QDownloadBatch)
+    Q_PROPERTY(
+        QString saveDirectory READ saveDirectory WRITE setSaveDirectory NOTIFY saveDirectoryChanged)
+    Q_PROPERTY(int maxConnections READ maxConnections WRITE setMaxConnections NOTIFY
+                   maxConnectionsChanged)
+    Q_PROPERTY(QString reportFile READ reportFile WRITE setReportFile NOTIFY reportFileChanged)
+    Q_PROPERTY(bool running READ isRunning NOTIFY runningChanged)
+
+public:
+    struct Entry
+    {
+        QString name = {};      // Relative to the save directory, may contain sub directories.
+        QList<QUrl> urls = {};  // The first one is preferred, the others are mirrors.
+        qint64 size = 0;        // Zero if unknown.
+        QByteArray sha256 = {}; // Empty if unknown.
+    };
+
+    enum class Status { Pending, Running, Succeeded, Failed, Skipped };
+    Q_ENUM(Status)
+
+    struct EntryResult
+    {
+        Status status = Status::Pending;
+        QDownloader::Result result = {};
+        int attempts = 0;
+    };
+
+    explicit QDownloadBatch(QObject *parent = nullptr);
+    ~QDownloadBatch() override;
+
+    static QList<Entry> loadManifest(const QString &filePath, bool *ok = nullptr);
+
+    QList<Entry> entries() const;
+    void setEntries(const QList<Entry> &value);
+    Entry entry(int index) const;
+
+    QList<EntryResult> results() const;
+    EntryResult result(int index) const;
+    QJsonObject report() const;
+
+    // Each downloaded file is verified against the manifest and then handed
+    // to the hooks on the post processor. New transfers are held back while
+    // the post processor is saturated.
+    QDownloadPostProcessor *postProcessor() const;
+    void setPostProcessor(QDownloadPostProcessor *value);
+    QList<QDownloader::PostProcessHook> postProcessHooks() const;
+    void setPostProcessHooks(const QList<QDownloader::PostProcessHook> &value);
+
+public Q_SLOTS:
+    void start();
+    void stop();
+
+    QString saveDirectory() const;
+    void setSaveDirectory(const QString &value);
+
+    // Transfers to one host are further limited by the maxConnections of
+    // QDownloader::hostCapabilities().
+    int maxConnections() const;
+    void setMaxConnections(int value = _WWX190_DL_DEFAULT_BATCH_CONNECTIONS);
+
+    // The report is rewritten whenever a file finishes. Files which have been
+    // downloaded according to an existing report are skipped by start(), so
+    // an interrupted batch can be resumed by starting it again.
+    QString reportFile() const;
+    void setReportFile(const QString &value);
+
+    bool isRunning() const;
+
+private:
+    QDownloader *takeDownloader();
+    void scheduleNext();
+    QUrl nextUrl(int index) const;
+    int nextQueuedEntry() const;
+    void startEntry(QDownloader *downloader, int index);
+    void onDownloaderFinished(QDownloader *downloader);
+    void restorePreviousReport();
+    void writeReport() const;
+
+Q_SIGNALS:
+    void entryFinished(int index);
+    void finished();
+    void saveDirectoryChanged();
+    void maxConnectionsChanged();
+    void reportFileChanged();
+    void runningChanged();
+
+private:
+    QList<Entry> m_entries = {};
+    QList<EntryResult> m_results = {};
+    QList<int> m_queue = {};
+    QHash<QDownloader *, int> m_active = {};
+    QHash<QDownloader *, QString> m_transferring = {}; // The origin of each transfer.
+    QList<QDownloader *> m_idle = {};
+    QString m_saveDirectory = {}, m_reportFile = {};
+    int m_maxConnections = _WWX190_DL_DEFAULT_BATCH_CONNECTIONS;
+    bool m_running = false;
+    QElapsedTimer m_timer = {};
+    qint64 m_startTime = 0, m_elapsed = 0;
+    QPointer<QDownloadPostProcessor> m_postProcessor = nullptr;
+    QList<QDownloader::PostProcessHook> m_postProcessHooks = {};
+};
+
+Q_DECLARE_METATYPE(QDownloadBatch::Entry)
+Q_DECLARE_METATYPE(QDownloadBatch::EntryResult)
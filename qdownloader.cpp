@@ -23,16 +23,26 @@
  */
 
 #include "qdownloader.h"
+#include "qdownloadpostprocessor.h"
 
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDeadlineTimer>
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
+#include <QFutureInterface>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QMimeDatabase>
+#include <QMutex>
 #include <QNetworkProxy>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QReadWriteLock>
+#include <QSet>
 #if (QT_VERSION < QT_VERSION_CHECK(5, 15, 0))
+#include <QTimer>
 #include <QTimerEvent>
 #endif
 
@@ -41,6 +51,8 @@ QDownloader::QDownloader(QObject *parent) : QObject(parent)
     qRegisterMetaType<Speed>();
     qRegisterMetaType<FileInfo>();
     qRegisterMetaType<Proxy>();
+    qRegisterMetaType<Result>();
+    qRegisterMetaType<HostCapabilities>();
     m_saveDirectory = QDir::toNativeSeparators(QCoreApplication::applicationDirPath());
     QNetworkProxyFactory::setUseSystemConfiguration(true);
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 9, 0))
@@ -50,7 +62,12 @@ QDownloader::QDownloader(QObject *parent) : QObject(parent)
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
     m_manager.setAutoDeleteReplies(true);
 #endif
-    connect(&m_manager, &QNetworkAccessManager::finished, this, &QDownloader::onFinished);
+    // The HEAD requests of startAsync() go through the same manager.
+    connect(&m_manager, &QNetworkAccessManager::finished, this, [this](QNetworkReply *reply) {
+        if (reply == m_reply) {
+            onFinished();
+        }
+    });
 }
 
 QDownloader::~QDownloader()
@@ -59,6 +76,305 @@ QDownloader::~QDownloader()
     stop();
 }
 
+namespace {
+
+class FileNameIndex
+{
+public:
+    QString find(const QString &value,
+                 const QString &dirPath,
+                 const QString &postfix,
+                 bool reserve);
+    void release(const QString &value, const QString &dirPath);
+    void commit(const QString &value, const QString &dirPath);
+    void rescan(const QString &dirPath);
+
+private:
+    struct Directory
+    {
+        QSet<QString> names = {};    // Found on disk.
+        QSet<QString> reserved = {}; // Reserved but not on disk yet.
+    };
+
+    Directory &directory(const QString &dirPath);
+
+    QMutex m_mutex;
+    QHash<QString, Directory> m_directories = {};
+};
+
+Q_GLOBAL_STATIC(FileNameIndex, fileNameIndex)
+
+inline QString indexKey(const QString &value)
+{
+#if defined(Q_OS_WIN) || defined(Q_OS_MACOS)
+    // The default file systems of these platforms are case-insensitive.
+    return value.toLower();
+#else
+    return value;
+#endif
+}
+
+inline QString directoryKey(const QString &dirPath)
+{
+    return indexKey(QDir::cleanPath(QDir(dirPath).absolutePath()));
+}
+
+// Splits "example.tar.gz" into "example" and "tar.gz", but still only splits
+// "my.file.with.dots.txt" into "my.file.with.dots" and "txt".
+void splitFileName(const QString &value, QString *baseName, QString *suffix)
+{
+    Q_ASSERT(baseName);
+    Q_ASSERT(suffix);
+    const QMimeDatabase mimeDatabase;
+    const QString knownSuffix = mimeDatabase.suffixForFileName(value);
+    if (!knownSuffix.isEmpty() && (knownSuffix.size() < value.size())) {
+        // Keep the original letter case of the file name.
+        *suffix = value.right(knownSuffix.size());
+        *baseName = value.left(value.size() - knownSuffix.size() - 1);
+    } else {
+        const QFileInfo fileInfo(value);
+        *suffix = fileInfo.suffix();
+        *baseName = fileInfo.completeBaseName();
+    }
+}
+
+FileNameIndex::Directory &FileNameIndex::directory(const QString &dirPath)
+{
+    // The directory is only scanned the first time, after that the index is
+    // kept up to date by ourself. Names taken by others are found when they
+    // are chosen, names freed by others are found by an explicit rescan.
+    const QString key = directoryKey(dirPath);
+    auto it = m_directories.find(key);
+    if (it != m_directories.end()) {
+        return it.value();
+    }
+    Directory &dir = m_directories[key];
+    const QStringList entryList = QDir(dirPath).entryList(QDir::AllEntries | QDir::Hidden
+                                                              | QDir::System | QDir::NoDotAndDotDot,
+                                                          QDir::NoSort);
+    dir.names.reserve(entryList.size());
+    for (auto &&entry : qAsConst(entryList)) {
+        dir.names.insert(indexKey(entry));
+    }
+    return dir;
+}
+
+QString FileNameIndex::find(const QString &value,
+                            const QString &dirPath,
+                            const QString &postfix,
+                            bool reserve)
+{
+    QString baseName = {}, suffix = {};
+    splitFileName(value, &baseName, &suffix);
+    const QString dotSuffix = suffix.isEmpty() ? QString{} : (QChar::fromLatin1('.') + suffix);
+    const QString dotPostfix = QChar::fromLatin1('.') + postfix;
+    QMutexLocker locker(&m_mutex);
+    Directory &dir = directory(dirPath);
+    const auto isTaken = [&dir](const QString &key) {
+        return dir.names.contains(key) || dir.reserved.contains(key);
+    };
+    QString fileName = value;
+    int i = 0;
+    while (true) {
+        const bool taken = isTaken(indexKey(fileName)) || isTaken(indexKey(fileName + dotPostfix));
+        if (!taken) {
+            // The index may be outdated if someone else touched the directory,
+            // confirm the chosen name only (instead of every probed name).
+            const QString filePath = QString::fromUtf8("%1/%2").arg(dirPath, fileName);
+            if (!QFile::exists(filePath) && !QFile::exists(filePath + dotPostfix)) {
+                break;
+            }
+            dir.names.insert(indexKey(fileName));
+        }
+        ++i;
+        fileName = QString::fromUtf8("%1 (%2)%3").arg(baseName, QString::number(i), dotSuffix);
+    }
+    if (reserve) {
+        dir.reserved.insert(indexKey(fileName));
+    }
+    return fileName + dotPostfix;
+}
+
+void FileNameIndex::release(const QString &value, const QString &dirPath)
+{
+    QMutexLocker locker(&m_mutex);
+    const auto it = m_directories.find(directoryKey(dirPath));
+    if (it != m_directories.end()) {
+        it.value().reserved.remove(indexKey(value));
+    }
+}
+
+void FileNameIndex::commit(const QString &value, const QString &dirPath)
+{
+    QMutexLocker locker(&m_mutex);
+    const auto it = m_directories.find(directoryKey(dirPath));
+    if (it != m_directories.end()) {
+        // The file is on disk now, only a rescan drops it if it's deleted.
+        const QString key = indexKey(value);
+        it.value().reserved.remove(key);
+        it.value().names.insert(key);
+    }
+}
+
+void FileNameIndex::rescan(const QString &dirPath)
+{
+    QMutexLocker locker(&m_mutex);
+    const auto it = m_directories.find(directoryKey(dirPath));
+    if (it != m_directories.end()) {
+        // Keep the reservations, they are not on disk yet.
+        const QSet<QString> reserved = it.value().reserved;
+        m_directories.erase(it);
+        directory(dirPath).reserved = reserved;
+    }
+}
+
+class HostCapabilitiesCache
+{
+public:
+    QDownloader::HostCapabilities value(const QUrl &url) const;
+    void update(const QUrl &url, const QNetworkReply *reply);
+    void setRangeSupport(const QUrl &url, QDownloader::RangeSupport value);
+    void clear();
+
+private:
+    static QString originKey(const QUrl &url);
+    static void updateMaxConnections(QDownloader::HostCapabilities *capabilities);
+
+    mutable QReadWriteLock m_lock;
+    QHash<QString, QDownloader::HostCapabilities> m_capabilities = {};
+};
+
+Q_GLOBAL_STATIC(HostCapabilitiesCache, hostCapabilitiesCache)
+
+QString HostCapabilitiesCache::originKey(const QUrl &url)
+{
+    const QString scheme = url.scheme().toLower();
+    const int defaultPort = (scheme == QString::fromUtf8("https")) ? 443 : 80;
+    return QString::fromUtf8("%1://%2:%3")
+        .arg(scheme, url.host().toLower(), QString::number(url.port(defaultPort)));
+}
+
+void HostCapabilitiesCache::updateMaxConnections(QDownloader::HostCapabilities *capabilities)
+{
+    Q_ASSERT(capabilities);
+    // Clients should not open more than one HTTP/2 connection to a host (RFC
+    // 7540 9.1). Otherwise use the per host limit of QNetworkAccessManager.
+    capabilities->maxConnections = capabilities->http2 ? 1 : 6;
+}
+
+QDownloader::HostCapabilities HostCapabilitiesCache::value(const QUrl &url) const
+{
+    QReadLocker locker(&m_lock);
+    return m_capabilities.value(originKey(url));
+}
+
+void HostCapabilitiesCache::update(const QUrl &url, const QNetworkReply *reply)
+{
+    Q_ASSERT(reply);
+    const QByteArray acceptRanges = reply->rawHeader("Accept-Ranges").trimmed().toLower();
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    const bool http2 = reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool();
+#elif (QT_VERSION >= QT_VERSION_CHECK(5, 9, 0))
+    const bool http2 = reply->attribute(QNetworkRequest::HTTP2WasUsedAttribute).toBool();
+#else
+    const bool http2 = false;
+#endif
+    QWriteLocker locker(&m_lock);
+    QDownloader::HostCapabilities &capabilities = m_capabilities[originKey(url)];
+    capabilities.http2 = http2;
+    if (acceptRanges == "none") {
+        capabilities.ranges = QDownloader::RangeSupport::Unsupported;
+    } else if ((acceptRanges == "bytes")
+               && (capabilities.ranges == QDownloader::RangeSupport::Unknown)) {
+        // What the server really does with a range request wins over what it
+        // advertises, so don't override a verified or observed result.
+        capabilities.ranges = QDownloader::RangeSupport::Advertised;
+    }
+    updateMaxConnections(&capabilities);
+}
+
+void HostCapabilitiesCache::setRangeSupport(const QUrl &url, QDownloader::RangeSupport value)
+{
+    QWriteLocker locker(&m_lock);
+    QDownloader::HostCapabilities &capabilities = m_capabilities[originKey(url)];
+    capabilities.ranges = value;
+    updateMaxConnections(&capabilities);
+}
+
+void HostCapabilitiesCache::clear()
+{
+    QWriteLocker locker(&m_lock);
+    m_capabilities.clear();
+}
+
+// Parses "bytes 100-999/1000", the total is -1 if the server doesn't know it.
+bool parseContentRange(const QByteArray &value, qint64 *first, qint64 *total)
+{
+    Q_ASSERT(first);
+    Q_ASSERT(total);
+    const QByteArray range = value.trimmed();
+    if (!range.toLower().startsWith("bytes ")) {
+        return false;
+    }
+    const int dash = range.indexOf('-', 6);
+    const int slash = range.indexOf('/', dash);
+    if ((dash < 0) || (slash < 0)) {
+        return false;
+    }
+    bool ok = false;
+    *first = range.mid(6, dash - 6).trimmed().toLongLong(&ok);
+    if (!ok) {
+        return false;
+    }
+    const QByteArray length = range.mid(slash + 1).trimmed();
+    if (length == "*") {
+        *total = -1;
+        return true;
+    }
+    *total = length.toLongLong(&ok);
+    return ok;
+}
+
+// Reads the answer of a HEAD request, the file name falls back to the one in
+// the URL.
+QDownloader::FileInfo fileInfoFromReply(const QNetworkReply *reply, const QUrl &url, bool *ok)
+{
+    Q_ASSERT(reply);
+    QDownloader::FileInfo fileInfo = {};
+    if (reply->error() != QNetworkReply::NoError) {
+        qDebug() << "Failed to query file information from server:" << reply->errorString();
+        fileInfo.fileName = url.fileName();
+        if (ok) {
+            *ok = false;
+        }
+        return fileInfo;
+    }
+    hostCapabilitiesCache()->update(reply->url(), reply);
+    fileInfo.fileType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
+    fileInfo.fileSize = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+    if (fileInfo.fileSize <= 0) {
+        fileInfo.fileSize = 0;
+        qDebug() << "Failed to query file size from server.";
+    }
+    const QString disposition = reply->header(QNetworkRequest::ContentDispositionHeader).toString();
+    const int index = disposition.indexOf(QString::fromUtf8("filename="), Qt::CaseInsensitive);
+    const QString fileName = disposition.mid(index + 9);
+    if (fileName.isEmpty()) {
+        qDebug() << "Failed to query file name from server. Using "
+                    "the default file name parsed from the URL "
+                    "instead.";
+        fileInfo.fileName = url.fileName();
+    } else {
+        fileInfo.fileName = fileName;
+    }
+    if (ok) {
+        *ok = true;
+    }
+    return fileInfo;
+}
+
+} // namespace
+
 QString QDownloader::uniqueFileName(const QString &value,
                                     const QString &dirPath,
                                     const QString &postfix)
@@ -66,21 +382,220 @@ QString QDownloader::uniqueFileName(const QString &value,
     if (value.isEmpty() || dirPath.isEmpty() || postfix.isEmpty()) {
         return {};
     }
-    const QFileInfo fileInfo(value);
-    // FIXME: example.tar.gz -> example.tar (1).gz
-    // Not good! Should be example (1).tar.gz
-    const QString suffix = fileInfo.suffix();
-    QString baseName = fileInfo.completeBaseName();
-    if (QFile::exists(QString::fromUtf8("%1/%2").arg(dirPath, value))) {
-        int i = 1;
-        baseName += QString::fromUtf8(" (");
-        while (QFile::exists(
-            QString::fromUtf8("%1/%2%3).%4").arg(dirPath, baseName, QString::number(i), suffix))) {
-            ++i;
+    return fileNameIndex()->find(value, dirPath, postfix, false);
+}
+
+QString QDownloader::reserveFileName(const QString &value,
+                                     const QString &dirPath,
+                                     const QString &postfix)
+{
+    if (value.isEmpty() || dirPath.isEmpty() || postfix.isEmpty()) {
+        return {};
+    }
+    return fileNameIndex()->find(value, dirPath, postfix, true);
+}
+
+void QDownloader::releaseFileName(const QString &value, const QString &dirPath)
+{
+    if (value.isEmpty() || dirPath.isEmpty()) {
+        return;
+    }
+    fileNameIndex()->release(value, dirPath);
+}
+
+void QDownloader::rescanFileNames(const QString &dirPath)
+{
+    if (dirPath.isEmpty()) {
+        return;
+    }
+    fileNameIndex()->rescan(dirPath);
+}
+
+void QDownloader::releaseReservation()
+{
+    if (!m_reservedFileName.isEmpty()) {
+        releaseFileName(m_reservedFileName, m_saveDirectory);
+        m_reservedFileName.clear();
+    }
+}
+
+QDownloader::HostCapabilities QDownloader::hostCapabilities(const QUrl &url)
+{
+    return hostCapabilitiesCache()->value(url);
+}
+
+void QDownloader::clearHostCapabilities()
+{
+    hostCapabilitiesCache()->clear();
+}
+
+bool QDownloader::checkResponse()
+{
+    m_responseChecked = true;
+    const bool wasSupported = breakpointSupported();
+    // Redirections are followed by the network access manager, the response
+    // belongs to the server of the final URL.
+    const QUrl url = m_reply->url();
+    m_responseUrl = url;
+    hostCapabilitiesCache()->update(url, m_reply);
+    if (m_currentReceivedBytes > 0) {
+        // We asked for a range, make sure we got exactly that range.
+        const int status = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status == 206) {
+            qint64 first = -1, total = -1;
+            const bool ok = parseContentRange(m_reply->rawHeader("Content-Range"), &first, &total);
+            if (!ok || (first != m_currentReceivedBytes)) {
+                qDebug() << "The server returned an unexpected range. Restarting the download.";
+                hostCapabilitiesCache()->setRangeSupport(url, RangeSupport::Unsupported);
+                restartDownload();
+                return false;
+            }
+            if ((total >= 0) && (m_fileInfo.fileSize > 0) && (total != m_fileInfo.fileSize)) {
+                qDebug() << "The remote file has changed. Restarting the download.";
+                restartDownload();
+                return false;
+            }
+            hostCapabilitiesCache()->setRangeSupport(url, RangeSupport::Verified);
+        } else if (status == 200) {
+            // The server sends the whole file again, don't append it to the
+            // partial one.
+            qDebug() << "The server ignored the range request. Restarting from the beginning.";
+            hostCapabilitiesCache()->setRangeSupport(url, RangeSupport::Unsupported);
+            if (!m_file.resize(0)) {
+                const QString errorString = QString::fromUtf8(R"(Truncating file "%1" failed: %2)")
+                                                .arg(QDir::toNativeSeparators(m_file.fileName()),
+                                                     m_file.errorString());
+                qDebug() << errorString;
+                failDownload(Error::FileError, errorString);
+                return false;
+            }
+            m_hash.reset();
+            m_currentReceivedBytes = 0;
         }
-        baseName += QString::number(i) + QChar::fromLatin1(')');
     }
-    return QString::fromUtf8("%1.%2.%3").arg(baseName, suffix, postfix);
+    if (breakpointSupported() != wasSupported) {
+        Q_EMIT breakpointSupportedChanged();
+    }
+    return true;
+}
+
+void QDownloader::failDownload(Error error, const QString &errorString)
+{
+    // Keeps onFinished() away from the aborted reply, the result is set here.
+    m_paused = true;
+    stopDownload();
+    m_paused = false;
+    if (m_file.exists()) {
+        m_file.remove();
+    }
+    releaseReservation();
+    setResult(error, errorString);
+    resetData();
+    Q_EMIT finished();
+}
+
+void QDownloader::restartDownload()
+{
+    // Keeps onFinished() away from the aborted reply.
+    m_paused = true;
+    stopDownload();
+    m_paused = false;
+    m_file.remove();
+    m_currentReceivedBytes = 0;
+    start_internal();
+}
+
+QFuture<QDownloader::Result> QDownloader::download(const QUrl &url,
+                                                    const QString &saveDirectory)
+{
+    QFutureInterface<Result> promise;
+    promise.reportStarted();
+    const QFuture<Result> future = promise.future();
+    const auto downloader = new QDownloader;
+    const auto watcher = new QFutureWatcher<Result>(downloader);
+    connect(watcher, &QFutureWatcherBase::canceled, downloader, [downloader, promise]() mutable {
+        downloader->disconnect();
+        downloader->stop();
+        promise.reportFinished();
+        downloader->deleteLater();
+    });
+    watcher->setFuture(future);
+    const auto reportResult = [downloader, watcher, promise]() mutable {
+        watcher->disconnect();
+        downloader->disconnect();
+        promise.reportResult(downloader->m_result);
+        promise.reportFinished();
+        downloader->deleteLater();
+    };
+    connect(downloader, &QDownloader::finished, downloader, reportResult);
+    if (!saveDirectory.isEmpty()) {
+        downloader->setSaveDirectory(saveDirectory);
+    }
+    downloader->setUrl(url);
+    // Unlike start(), startAsync() doesn't wait for the HEAD request in a
+    // nested event loop, so many downloads can be fanned out without blocking.
+    downloader->startAsync();
+    return future;
+}
+
+QDownloadPostProcessor *QDownloader::postProcessor() const
+{
+    return m_postProcessor;
+}
+
+void QDownloader::setPostProcessor(QDownloadPostProcessor *value)
+{
+    m_postProcessor = value;
+}
+
+QList<QDownloader::PostProcessHook> QDownloader::postProcessHooks() const
+{
+    return m_postProcessHooks;
+}
+
+void QDownloader::setPostProcessHooks(const QList<PostProcessHook> &value)
+{
+    m_postProcessHooks = value;
+}
+
+void QDownloader::finishPostProcess(quint64 serial,
+                                    bool ok,
+                                    const QString &errorString,
+                                    qint64 elapsed)
+{
+    // Ignore jobs of a download which has been stopped meanwhile.
+    if (!m_postProcessing || (serial != m_postProcessSerial)) {
+        return;
+    }
+    m_postProcessing = false;
+    m_result.postProcessElapsed = elapsed;
+    if (!ok) {
+        qDebug() << "Post processing failed:" << errorString;
+        m_result.error = Error::PostProcessError;
+        m_result.errorString = errorString;
+    }
+    Q_EMIT finished();
+}
+
+QDownloader::Result QDownloader::result() const
+{
+    return m_result;
+}
+
+void QDownloader::setResult(Error error, const QString &errorString)
+{
+    m_result.url = m_url;
+    m_result.error = error;
+    m_result.errorString = errorString;
+    m_result.elapsed = m_elapsedTimer.isValid() ? m_elapsedTimer.elapsed() : 0;
+    if (error == Error::NoError) {
+        m_result.fileSize = m_file.size();
+        m_result.digest = m_hash.result();
+    } else {
+        m_result.filePath.clear();
+        m_result.fileSize = 0;
+        m_result.digest.clear();
+    }
 }
 
 void QDownloader::start_internal()
@@ -93,20 +608,30 @@ void QDownloader::start_internal()
     }
     const bool append = breakpointSupported() && (m_currentReceivedBytes > 0);
     if (!append) {
-        m_file.setFileName(QString::fromUtf8("%1/%2").arg(m_saveDirectory,
-                                                          uniqueFileName(m_fileInfo.fileName,
-                                                                         m_saveDirectory,
-                                                                         m_downloadingPostfix)));
+        releaseReservation();
+        const QString fileName = reserveFileName(m_fileInfo.fileName,
+                                                 m_saveDirectory,
+                                                 m_downloadingPostfix);
+        m_reservedFileName = QFileInfo(fileName).completeBaseName();
+        m_file.setFileName(QString::fromUtf8("%1/%2").arg(m_saveDirectory, fileName));
     }
     if ((m_currentReceivedBytes <= 0) && m_file.exists()) {
         m_file.remove();
     }
+    if (!append) {
+        m_hash.reset();
+    }
     if (!m_file.open(QFile::WriteOnly | (append ? QFile::Append : QFile::Truncate))) {
         qDebug() << "Cannot open file for writing.";
+        releaseReservation();
+        setResult(Error::FileError, m_file.errorString());
+        resetData();
+        Q_EMIT finished();
         return;
     }
     m_downloading = true;
     m_paused = false;
+    m_responseChecked = false;
     m_speedTimer.start();
 #if (QT_VERSION < QT_VERSION_CHECK(5, 15, 0))
     m_timeoutTimerId = startTimer(m_timeout);
@@ -199,6 +724,9 @@ QDownloader::Speed QDownloader::speed() const
 void QDownloader::resetData()
 {
     m_url.clear();
+    m_expectedFileSize = 0;
+    m_expectedDigest.clear();
+    m_responseUrl.clear();
     m_progress = 0.0;
     m_speed.value = 0.0;
     m_speed.unit.clear();
@@ -210,6 +738,7 @@ void QDownloader::resetData()
     m_fileInfo.fileType.clear();
     m_fileInfo.fileSize = 0;
     m_paused = false;
+    m_asyncFileInfo = false;
     m_bytesreceived_timer = 0;
     m_timeoutTimerId = 0;
 }
@@ -222,7 +751,10 @@ void QDownloader::onReadyRead()
     if (!m_file.isOpen()) {
         // FIXME: Stop and exit or re-open it and continue?
         qDebug() << "Internal error: file is not open for writing. Aborting...";
-        stop();
+        failDownload(Error::FileError, QString::fromUtf8("The file is not open for writing."));
+        return;
+    }
+    if (!m_responseChecked && !checkResponse()) {
         return;
     }
     // The following code is copied from Qt Installer Framework.
@@ -233,11 +765,14 @@ void QDownloader::onReadyRead()
         while (written < read) {
             const qint64 toWrite = m_file.write(buffer.constData() + written, read - written);
             if (toWrite < 0) {
-                qDebug() << QString::fromUtf8(R"(Writing to file "%1" failed: %2)")
-                                .arg(QDir::toNativeSeparators(m_file.fileName()),
-                                     m_file.errorString());
+                const QString errorString = QString::fromUtf8(R"(Writing to file "%1" failed: %2)")
+                                                .arg(QDir::toNativeSeparators(m_file.fileName()),
+                                                     m_file.errorString());
+                qDebug() << errorString;
+                failDownload(Error::FileError, errorString);
                 return;
             }
+            m_hash.addData(buffer.constData() + written, toWrite);
             written += toWrite;
         }
     }
@@ -262,33 +797,68 @@ void QDownloader::onFinished()
         m_file.remove();
         m_url = m_reply->url().resolved(
             m_reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl());
+        m_reply->deleteLater();
+        m_reply = nullptr;
+        Q_EMIT urlChanged();
         // Update file information from the redirected url, but don't change the
         // file name as the new file name returned by the server may be invalid.
+        if (m_asyncFileInfo) {
+            // Downloads the real file when the server has answered.
+            queryFileInfo(true);
+            return;
+        }
         const FileInfo _fi = getRemoteFileInfo(m_url);
         m_fileInfo.fileType = _fi.fileType;
         m_fileInfo.fileSize = _fi.fileSize;
         Q_EMIT fileInfoChanged();
-        m_reply->deleteLater();
-        m_reply = nullptr;
-        Q_EMIT urlChanged();
         // Download the real file.
         start_internal();
         return;
     }
-    if (m_reply->error() == QNetworkReply::NoError) {
+    const QString mismatch = (m_reply->error() == QNetworkReply::NoError) ? verifyFile()
+                                                                          : QString{};
+    if (!mismatch.isEmpty()) {
+        // Never hand out a file which doesn't match, and free its name for a
+        // retry.
+        qDebug() << "Verification failed:" << mismatch;
+        m_file.remove();
+        releaseReservation();
+        setResult(Error::IntegrityError, mismatch);
+    } else if (m_reply->error() == QNetworkReply::NoError) {
         // Remove the temporary file extension name.
-        if (!m_file.rename(QString::fromUtf8("%1/%2").arg(m_saveDirectory,
-                                                          QFileInfo(m_file).completeBaseName()))) {
+        if (m_file.rename(QString::fromUtf8("%1/%2").arg(m_saveDirectory,
+                                                         QFileInfo(m_file).completeBaseName()))) {
+            setResult(Error::NoError);
+        } else {
             qDebug() << "Failed to rename the downloaded file. Check your "
                         "anti-virous software.";
+            setResult(Error::FileError, m_file.errorString());
         }
+        m_result.filePath = QDir::toNativeSeparators(m_file.fileName());
+        // The reserved name is occupied by the downloaded file from now on.
+        fileNameIndex()->commit(m_reservedFileName, m_saveDirectory);
+        m_reservedFileName.clear();
     } else {
         m_file.remove();
+        releaseReservation();
         qDebug() << "Download failed:" << m_reply->errorString();
+        setResult(Error::NetworkError, m_reply->errorString());
     }
     m_reply->deleteLater();
     m_reply = nullptr;
     resetData();
+    if (m_result.error != Error::NoError) {
+        Q_EMIT finished();
+        return;
+    }
+    // Don't block the thread of the downloader, finished() will be emitted by
+    // finishPostProcess().
+    m_postProcessing = m_postProcessor && !m_postProcessHooks.isEmpty();
+    Q_EMIT downloaded();
+    if (m_postProcessing) {
+        m_postProcessor->submit(this, ++m_postProcessSerial, m_result, m_postProcessHooks);
+        return;
+    }
     Q_EMIT finished();
 }
 
@@ -325,37 +895,165 @@ void QDownloader::stop()
     if ((QFileInfo(m_file).suffix() == m_downloadingPostfix) && m_file.exists()) {
         m_file.remove();
     }
+    releaseReservation();
     resetData();
+    m_postProcessing = false;
 }
 
-void QDownloader::start()
+bool QDownloader::prepareStart()
 {
     if (m_paused) {
         qDebug() << "Use the \"Downloader::resume()\" method to re-start a "
                     "paused download.";
-        return;
+        return false;
     }
-    if (m_downloading) {
+    if (m_downloading || m_headReply) {
         qDebug() << "Stop the current download task first before start a new one.";
-        return;
+        return false;
     }
+    if (m_postProcessing) {
+        qDebug() << "Wait for the post processing of the current download task to finish.";
+        return false;
+    }
+    m_result = {};
+    m_result.url = m_url;
+    m_result.startTime = QDateTime::currentMSecsSinceEpoch();
+    m_elapsedTimer.start();
     if (!m_url.isValid() || m_saveDirectory.isEmpty()) {
         qDebug() << "The URL is not valid and/or the save directory is not set.";
-        return;
+        setResult(Error::InvalidArguments,
+                  QString::fromUtf8("The URL is not valid and/or the save directory is not set."));
+        Q_EMIT finished();
+        return false;
+    }
+    return true;
+}
+
+bool QDownloader::hasPresetFileInfo() const
+{
+    return !m_presetFileInfo.fileName.isEmpty() && (m_presetFileInfo.fileSize > 0);
+}
+
+void QDownloader::applyFileInfo(const FileInfo &remote)
+{
+    if (hasPresetFileInfo()) {
+        m_fileInfo = m_presetFileInfo;
+    } else {
+        m_fileInfo = remote;
+        if (!m_presetFileInfo.fileName.isEmpty()) {
+            m_fileInfo.fileName = m_presetFileInfo.fileName;
+        }
     }
-    m_fileInfo = getRemoteFileInfo(m_url);
+    m_presetFileInfo = {};
     Q_EMIT fileInfoChanged();
     Q_EMIT breakpointSupportedChanged();
+}
+
+void QDownloader::queryFileInfo(bool redirected)
+{
+    QNetworkRequest request(m_url);
+#if (QT_VERSION < QT_VERSION_CHECK(5, 9, 0))
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+#else
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                         QNetworkRequest::NoLessSafeRedirectPolicy);
+#endif
+    m_headReply = m_manager.head(request);
+#if (QT_VERSION < QT_VERSION_CHECK(5, 15, 0))
+    // The manager has no transfer timeout.
+    QTimer::singleShot(m_timeout, m_headReply, &QNetworkReply::abort);
+#endif
+    connect(m_headReply, &QNetworkReply::finished, this, [this, redirected]() {
+        const FileInfo remote = fileInfoFromReply(m_headReply, m_url, nullptr);
+        m_headReply->disconnect();
+        m_headReply->deleteLater();
+        m_headReply = nullptr;
+        if (redirected) {
+            // Don't change the file name, see onFinished().
+            m_fileInfo.fileType = remote.fileType;
+            m_fileInfo.fileSize = remote.fileSize;
+            Q_EMIT fileInfoChanged();
+        } else {
+            applyFileInfo(remote);
+        }
+        start_internal();
+    });
+}
+
+void QDownloader::start()
+{
+    if (!prepareStart()) {
+        return;
+    }
+    m_asyncFileInfo = false;
+    applyFileInfo(hasPresetFileInfo() ? FileInfo{} : getRemoteFileInfo(m_url));
     // FIXME: Start too quickly causes problems?
     // QThread::usleep(50);
     start_internal();
 }
 
+void QDownloader::startAsync()
+{
+    if (!prepareStart()) {
+        return;
+    }
+    m_asyncFileInfo = true;
+    if (hasPresetFileInfo()) {
+        applyFileInfo({});
+        start_internal();
+        return;
+    }
+    queryFileInfo(false);
+}
+
 QDownloader::FileInfo QDownloader::fileInfo() const
 {
     return m_fileInfo;
 }
 
+void QDownloader::setFileInfo(const FileInfo &value)
+{
+    m_presetFileInfo = value;
+}
+
+qint64 QDownloader::expectedFileSize() const
+{
+    return m_expectedFileSize;
+}
+
+void QDownloader::setExpectedFileSize(qint64 value)
+{
+    m_expectedFileSize = qMax(value, qint64(0));
+}
+
+QByteArray QDownloader::expectedDigest() const
+{
+    return m_expectedDigest;
+}
+
+void QDownloader::setExpectedDigest(const QByteArray &value)
+{
+    m_expectedDigest = value;
+}
+
+QString QDownloader::verifyFile() const
+{
+    const qint64 fileSize = m_file.size();
+    if ((m_expectedFileSize > 0) && (fileSize != m_expectedFileSize)) {
+        return QString::fromUtf8("Size mismatch: expected %1, got %2.")
+            .arg(QString::number(m_expectedFileSize), QString::number(fileSize));
+    }
+    if (!m_expectedDigest.isEmpty()) {
+        const QByteArray digest = m_hash.result();
+        if (digest != m_expectedDigest) {
+            return QString::fromUtf8("SHA-256 mismatch: expected %1, got %2.")
+                .arg(QString::fromLatin1(m_expectedDigest.toHex()),
+                     QString::fromLatin1(digest.toHex()));
+        }
+    }
+    return {};
+}
+
 void QDownloader::pause()
 {
     if (!m_downloading || m_paused) {
@@ -370,7 +1068,9 @@ void QDownloader::pause()
     }
     m_paused = true;
     stopDownload();
-    m_currentReceivedBytes += m_receivedBytes;
+    // The progress lags behind what has been written, resume from the end of
+    // the file instead, checkResponse() expects the range to start there.
+    m_currentReceivedBytes = m_file.size();
 }
 
 void QDownloader::stopDownload()
@@ -378,6 +1078,12 @@ void QDownloader::stopDownload()
 #if (QT_VERSION < QT_VERSION_CHECK(5, 15, 0))
     killTimer(m_timeoutTimerId);
 #endif
+    if (m_headReply) {
+        m_headReply->disconnect();
+        m_headReply->abort();
+        m_headReply->deleteLater();
+        m_headReply = nullptr;
+    }
     if (m_reply) {
         m_reply->disconnect();
         if (m_reply->isRunning()) {
@@ -474,39 +1180,7 @@ QDownloader::FileInfo QDownloader::getRemoteFileInfo(const QUrl &val,
 #endif
         QNetworkReply *headReply = headManager.head(headRequest);
         connect(headReply, &QNetworkReply::finished, [headReply, val, ok, &headFileInfo, &ready]() {
-            if (headReply->error() == QNetworkReply::NoError) {
-                headFileInfo.fileType = headReply->header(QNetworkRequest::ContentTypeHeader)
-                                            .toString();
-                headFileInfo.fileSize = headReply->header(QNetworkRequest::ContentLengthHeader)
-                                            .toLongLong();
-                if (headFileInfo.fileSize <= 0) {
-                    headFileInfo.fileSize = 0;
-                    qDebug() << "Failed to query file size from server.";
-                }
-                const QString disposition
-                    = headReply->header(QNetworkRequest::ContentDispositionHeader).toString();
-                const int index = disposition.indexOf(QString::fromUtf8("filename="),
-                                                      Qt::CaseInsensitive);
-                const QString fileName = disposition.mid(index + 9);
-                if (fileName.isEmpty()) {
-                    qDebug() << "Failed to query file name from server. Using "
-                                "the default file name parsed from the URL "
-                                "instead.";
-                    headFileInfo.fileName = val.fileName();
-                } else {
-                    headFileInfo.fileName = fileName;
-                }
-                if (ok) {
-                    *ok = true;
-                }
-            } else {
-                qDebug() << "Failed to query file information from server:"
-                         << headReply->errorString();
-                headFileInfo.fileName = val.fileName();
-                if (ok) {
-                    *ok = false;
-                }
-            }
+            headFileInfo = fileInfoFromReply(headReply, val, ok);
             headReply->disconnect();
             headReply->deleteLater();
             // headReply = nullptr;
@@ -523,12 +1197,12 @@ QDownloader::FileInfo QDownloader::getRemoteFileInfo(const QUrl &val,
 }
 
 #if (QT_VERSION < QT_VERSION_CHECK(5, 15, 0))
-void Downloader::timerEvent(QTimerEvent *event)
+void QDownloader::timerEvent(QTimerEvent *event)
 {
     if (event->timerId() == m_timeoutTimerId) {
         if (m_receivedBytes <= m_bytesreceived_timer) {
             qDebug() << "Error: network transfer timeout.";
-            stop();
+            failDownload(Error::NetworkError, QString::fromUtf8("Network transfer timeout."));
         }
     }
     QObject::timerEvent(event);
@@ -537,8 +1211,15 @@ void Downloader::timerEvent(QTimerEvent *event)
 
 bool QDownloader::breakpointSupported() const
 {
-    // FIXME: Is there an official way to judge this?
-    return m_url.scheme().startsWith(QString::fromUtf8("http"), Qt::CaseInsensitive);
+    if (!m_url.scheme().startsWith(QString::fromUtf8("http"), Qt::CaseInsensitive)) {
+        return false;
+    }
+    // Ask about the server which really answered, if it's known already. An
+    // unknown server is given a try, checkResponse() finds out whether the
+    // range request has been honored.
+    const RangeSupport ranges = hostCapabilities(m_responseUrl.isValid() ? m_responseUrl : m_url)
+                                    .ranges;
+    return ranges != RangeSupport::Unsupported;
 }
 
 QDownloader::Proxy QDownloader::proxy() const
@@ -25,16 +25,22 @@
 #pragma once
 
 #include "qdownloader_global.h"
+#include <QCryptographicHash>
 #include <QElapsedTimer>
 #include <QFile>
+#include <QFuture>
 #include <QNetworkAccessManager>
 #include <QObject>
+#include <QPointer>
 #include <QUrl>
+#include <functional>
 
 #define _WWX190_DL_DEFAULT_DOWNLOADING_POSTFIX "downloading"
 #define _WWX190_DL_DEFAULT_DOWNLOADING_TIMEOUT 3000
 #define _WWX190_DL_DEFAULT_DOWNLOADING_TRY_TIMES 5
 
+class QDownloadPostProcessor;
+
 class QDOWNLOADER_EXPORT QDownloader : public QObject
 {
     Q_OBJECT
@@ -77,6 +83,49 @@ public:
         QString password = {};
     };
 
+    enum class Error {
+        NoError,
+        InvalidArguments,
+        FileError,
+        NetworkError,
+        IntegrityError,
+        PostProcessError,
+        Canceled
+    };
+    Q_ENUM(Error)
+
+    struct Result
+    {
+        QUrl url = {};
+        QString filePath = {};
+        qint64 fileSize = 0;
+        QByteArray digest = {}; // SHA-256 of the downloaded data.
+        Error error = Error::NoError;
+        QString errorString = {};
+        qint64 startTime = 0; // Milliseconds since epoch.
+        qint64 elapsed = 0;   // Milliseconds.
+        qint64 postProcessElapsed = 0; // Milliseconds.
+    };
+
+    // Runs in a thread of the post processor after the downloaded file has been
+    // renamed. Report progress through status(), return false and set the
+    // error string to fail the task.
+    using PostProcessHook = std::function<bool(const Result &result,
+                                               const std::function<void(const QString &)> &status,
+                                               QString *errorString)>;
+
+    enum class RangeSupport { Unknown, Advertised, Verified, Unsupported };
+    Q_ENUM(RangeSupport)
+
+    struct HostCapabilities
+    {
+        RangeSupport ranges = RangeSupport::Unknown;
+        bool http2 = false;
+        // Parallel transfers worth running against the host, every downloader
+        // opens a connection of its own.
+        int maxConnections = 6;
+    };
+
     explicit QDownloader(QObject *parent = nullptr);
     ~QDownloader() override;
 
@@ -88,9 +137,39 @@ public:
         const QString &value,
         const QString &dirPath,
         const QString &postfix = QString::fromUtf8(_WWX190_DL_DEFAULT_DOWNLOADING_POSTFIX));
+    static QString reserveFileName(
+        const QString &value,
+        const QString &dirPath,
+        const QString &postfix = QString::fromUtf8(_WWX190_DL_DEFAULT_DOWNLOADING_POSTFIX));
+    static void releaseFileName(const QString &value, const QString &dirPath);
+    // The names in a directory are indexed once, call this after files have
+    // been removed from it by others to make their names available again.
+    static void rescanFileNames(const QString &dirPath);
+
+    // Capabilities are cached per origin (scheme, host and port) and shared by
+    // all downloaders, they are learned from every response of the server.
+    static HostCapabilities hostCapabilities(const QUrl &url);
+    static void clearHostCapabilities();
+
+    // The returned future finishes with the result of the download, canceling
+    // it stops the download. A canceled future has no result, read it with
+    // QDownloadFuture::result() or the QDownloadFuture combinators instead of
+    // QFuture::result(). The calling thread must run an event loop.
+    static QFuture<Result> download(const QUrl &url, const QString &saveDirectory);
+
+    // The hooks run one after another for every downloaded file, finished()
+    // is emitted when they are done while downloaded() is emitted as soon as
+    // the transfer is done. Nothing runs without a post processor.
+    QDownloadPostProcessor *postProcessor() const;
+    void setPostProcessor(QDownloadPostProcessor *value);
+    QList<PostProcessHook> postProcessHooks() const;
+    void setPostProcessHooks(const QList<PostProcessHook> &value);
 
 public Q_SLOTS:
     void start();
+    // Same as start(), but doesn't wait for the file information from the
+    // server, fileInfoChanged() is emitted when it has arrived.
+    void startAsync();
     void pause();
     void resume();
     void stop();
@@ -109,6 +188,18 @@ public Q_SLOTS:
     Speed speed() const;
 
     FileInfo fileInfo() const;
+    // Used by the next start() or startAsync() instead of asking the server.
+    // A known file size saves the HEAD request, a known file name overrides
+    // the server's.
+    void setFileInfo(const FileInfo &value);
+
+    // Checked before the downloaded file is renamed, a mismatching file is
+    // removed and reported as Error::IntegrityError. Zero and empty values
+    // mean unknown. Both are reset when the download ends.
+    qint64 expectedFileSize() const;
+    void setExpectedFileSize(qint64 value);
+    QByteArray expectedDigest() const; // SHA-256.
+    void setExpectedDigest(const QByteArray &value);
 
     QString downloadingPostfix() const;
     void setDownloadingPostfix(
@@ -119,6 +210,8 @@ public Q_SLOTS:
     Proxy proxy() const;
     void setProxy(Proxy val);
 
+    Result result() const;
+
 #if (QT_VERSION < QT_VERSION_CHECK(5, 15, 0))
 protected:
     void timerEvent(QTimerEvent *event) override;
@@ -131,11 +224,24 @@ private Q_SLOTS:
 
 private:
     void start_internal();
+    bool prepareStart();
+    bool hasPresetFileInfo() const;
+    void applyFileInfo(const FileInfo &remote);
+    void queryFileInfo(bool redirected);
     void resetData();
     void stopDownload();
+    void releaseReservation();
+    void setResult(Error error, const QString &errorString = {});
+    bool checkResponse();
+    void restartDownload();
+    void failDownload(Error error, const QString &errorString);
+    QString verifyFile() const;
+    void finishPostProcess(quint64 serial, bool ok, const QString &errorString, qint64 elapsed);
 
 Q_SIGNALS:
     void finished();
+    void downloaded();
+    void postProcessStatusChanged(const QString &status);
     void progressChanged();
     void speedChanged();
     void fileInfoChanged();
@@ -147,22 +253,35 @@ Q_SIGNALS:
     void proxyChanged();
 
 private:
-    QUrl m_url = {};
+    QUrl m_url = {}, m_responseUrl = {};
     QFile m_file = {};
     QNetworkAccessManager m_manager;
-    QNetworkReply *m_reply = nullptr;
-    QElapsedTimer m_speedTimer = {};
+    QNetworkReply *m_reply = nullptr, *m_headReply = nullptr;
+    QElapsedTimer m_speedTimer = {}, m_elapsedTimer = {};
+    QCryptographicHash m_hash{QCryptographicHash::Sha256};
     QString m_saveDirectory = {},
             m_downloadingPostfix = QString::fromUtf8(_WWX190_DL_DEFAULT_DOWNLOADING_POSTFIX);
     qreal m_progress = 0.0;
     int m_timeout = _WWX190_DL_DEFAULT_DOWNLOADING_TIMEOUT, m_timeoutTimerId = 0;
     Speed m_speed = {};
-    bool m_downloading = false, m_paused = false;
+    bool m_downloading = false, m_paused = false, m_responseChecked = false,
+         m_postProcessing = false, m_asyncFileInfo = false;
+    quint64 m_postProcessSerial = 0;
     qint64 m_receivedBytes = 0, m_totalBytes = 0, m_currentReceivedBytes = 0,
            m_bytesreceived_timer = 0;
-    FileInfo m_fileInfo = {};
+    FileInfo m_fileInfo = {}, m_presetFileInfo = {};
+    qint64 m_expectedFileSize = 0;
+    QByteArray m_expectedDigest = {};
+    QString m_reservedFileName = {};
+    Result m_result = {};
+    QPointer<QDownloadPostProcessor> m_postProcessor = nullptr;
+    QList<PostProcessHook> m_postProcessHooks = {};
+
+    friend class QDownloadPostProcessor;
 };
 
 Q_DECLARE_METATYPE(QDownloader::Speed)
 Q_DECLARE_METATYPE(QDownloader::FileInfo)
 Q_DECLARE_METATYPE(QDownloader::Proxy)
+Q_DECLARE_METATYPE(QDownloader::Result)
+Q_DECLARE_METATYPE(QDownloader::HostCapabilities)
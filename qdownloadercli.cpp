@@ -0,0 +1,102 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2020 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "qdownloadbatch.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QTextStream>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    QCoreApplication::setApplicationName(QString::fromUtf8("QDownloaderCli"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QString::fromUtf8("Downloads all files of a Metalink or JSON manifest."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QString::fromUtf8("manifest"),
+                                 QString::fromUtf8("The manifest file."));
+    const QCommandLineOption outputOption({QString::fromUtf8("o"), QString::fromUtf8("output")},
+                                          QString::fromUtf8("Save the files to <directory>."),
+                                          QString::fromUtf8("directory"),
+                                          QDir::currentPath());
+    const QCommandLineOption connectionsOption(
+        {QString::fromUtf8("j"), QString::fromUtf8("connections")},
+        QString::fromUtf8("Download at most <count> files at the same time."),
+        QString::fromUtf8("count"),
+        QString::number(_WWX190_DL_DEFAULT_BATCH_CONNECTIONS));
+    const QCommandLineOption reportOption(
+        {QString::fromUtf8("r"), QString::fromUtf8("report")},
+        QString::fromUtf8("Write the JSON report to <file>, an existing report resumes the batch."),
+        QString::fromUtf8("file"));
+    parser.addOption(outputOption);
+    parser.addOption(connectionsOption);
+    parser.addOption(reportOption);
+    parser.process(application);
+
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() != 1) {
+        parser.showHelp(1);
+    }
+
+    const QString manifest = arguments.constFirst();
+    bool ok = false;
+    const QList<QDownloadBatch::Entry> entries = QDownloadBatch::loadManifest(manifest, &ok);
+    if (!ok) {
+        QTextStream(stderr) << "Cannot load the manifest: " << manifest << '\n';
+        return 1;
+    }
+
+    QDownloadBatch batch;
+    batch.setEntries(entries);
+    batch.setSaveDirectory(parser.value(outputOption));
+    batch.setMaxConnections(parser.value(connectionsOption).toInt());
+    batch.setReportFile(parser.value(reportOption));
+    QObject::connect(&batch, &QDownloadBatch::entryFinished, &batch, [&batch](int index) {
+        const QDownloadBatch::EntryResult entryResult = batch.result(index);
+        QTextStream out(stdout);
+        if (entryResult.status == QDownloadBatch::Status::Succeeded) {
+            out << "[OK] " << entryResult.result.filePath << '\n';
+        } else {
+            out << "[FAILED] " << batch.entry(index).name << ": "
+                << entryResult.result.errorString << '\n';
+        }
+    });
+    QObject::connect(&batch, &QDownloadBatch::finished, &application, [&batch]() {
+        const QJsonObject report = batch.report();
+        const int failed = report.value(QString::fromUtf8("failed")).toInt();
+        QTextStream(stdout) << "Succeeded: " << report.value(QString::fromUtf8("succeeded")).toInt()
+                            << ", failed: " << failed
+                            << ", skipped: " << report.value(QString::fromUtf8("skipped")).toInt()
+                            << ", throughput: "
+                            << report.value(QString::fromUtf8("throughput")).toDouble() / 1024.0
+                            << " KB/s\n";
+        QCoreApplication::exit((failed > 0) ? 1 : 0);
+    });
+    QMetaObject::invokeMethod(&batch, &QDownloadBatch::start, Qt::QueuedConnection);
+    return QCoreApplication::exec();
+}
@@ -0,0 +1,147 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2020 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "qdownloadfuture.h"
+
+#include <QFutureInterface>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+
+QDownloadFuture::Result QDownloadFuture::result(const QFuture<Result> &future)
+{
+    if (!future.isCanceled()) {
+        QFuture<Result>(future).waitForFinished();
+    }
+    if (future.isCanceled() || (future.resultCount() < 1)) {
+        Result canceled = {};
+        canceled.error = QDownloader::Error::Canceled;
+        canceled.errorString = QString::fromUtf8("The download has been canceled.");
+        return canceled;
+    }
+    return future.result();
+}
+
+QFuture<QList<QDownloadFuture::Result>> QDownloadFuture::whenAll(
+    const QList<QFuture<Result>> &futures)
+{
+    struct State
+    {
+        QFutureInterface<QList<Result>> promise = {};
+        QList<Result> results = {};
+        int remaining = 0;
+    };
+    const auto state = QSharedPointer<State>::create();
+    state->promise.reportStarted();
+    const QFuture<QList<Result>> future = state->promise.future();
+    if (futures.isEmpty()) {
+        state->promise.reportResult(state->results);
+        state->promise.reportFinished();
+        return future;
+    }
+    for (int i = 0; i != futures.size(); ++i) {
+        state->results.append(Result{});
+    }
+    state->remaining = futures.size();
+    // All watchers share one parent so that they go away together.
+    const auto holder = new QObject;
+    const auto outputWatcher = new QFutureWatcher<QList<Result>>(holder);
+    QObject::connect(outputWatcher, &QFutureWatcherBase::canceled, holder, [futures]() {
+        cancelAll(futures);
+    });
+    outputWatcher->setFuture(future);
+    for (int i = 0; i != futures.size(); ++i) {
+        const auto watcher = new QFutureWatcher<Result>(holder);
+        const auto collect = [state, watcher, holder, i]() {
+            state->results[i] = result(watcher->future());
+            --state->remaining;
+            if (state->remaining == 0) {
+                state->promise.reportResult(state->results);
+                state->promise.reportFinished();
+                holder->deleteLater();
+            }
+        };
+        QObject::connect(watcher, &QFutureWatcherBase::finished, holder, collect);
+        watcher->setFuture(futures.at(i));
+    }
+    return future;
+}
+
+QFuture<QDownloadFuture::Result> QDownloadFuture::whenAny(const QList<QFuture<Result>> &futures)
+{
+    QFutureInterface<Result> promise;
+    promise.reportStarted();
+    const QFuture<Result> future = promise.future();
+    if (futures.isEmpty()) {
+        promise.reportResult(result(QFuture<Result>()));
+        promise.reportFinished();
+        return future;
+    }
+    const auto holder = new QObject;
+    const auto outputWatcher = new QFutureWatcher<Result>(holder);
+    const auto cancel = [promise, futures, holder]() mutable {
+        cancelAll(futures);
+        promise.reportFinished();
+        holder->deleteLater();
+    };
+    QObject::connect(outputWatcher, &QFutureWatcherBase::canceled, holder, cancel);
+    outputWatcher->setFuture(future);
+    for (auto &&input : qAsConst(futures)) {
+        const auto watcher = new QFutureWatcher<Result>(holder);
+        const auto take = [promise, watcher, holder]() mutable {
+            // Only the first finished future is taken into account.
+            if (promise.isFinished()) {
+                return;
+            }
+            promise.reportResult(result(watcher->future()));
+            promise.reportFinished();
+            holder->deleteLater();
+        };
+        QObject::connect(watcher, &QFutureWatcherBase::finished, holder, take);
+        watcher->setFuture(input);
+    }
+    return future;
+}
+
+void QDownloadFuture::cancelAll(const QList<QFuture<Result>> &futures)
+{
+    for (auto &&future : qAsConst(futures)) {
+        QFuture<Result> copy = future;
+        copy.cancel();
+    }
+}
+
+void QDownloadFuture::then(const QFuture<Result> &future,
+                           QObject *context,
+                           const std::function<void(const Result &)> &callback)
+{
+    if (!context || !callback) {
+        return;
+    }
+    const auto watcher = new QFutureWatcher<Result>(context);
+    QObject::connect(watcher, &QFutureWatcherBase::finished, context, [watcher, callback]() {
+        watcher->deleteLater();
+        callback(result(watcher->future()));
+    });
+    watcher->setFuture(future);
+}
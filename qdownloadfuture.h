@@ -0,0 +1,62 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2020 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "qdownloader.h"
+#include <QList>
+#include <functional>
+
+// Combinators for the futures returned by QDownloader::download().
+class QDOWNLOADER_EXPORT QDownloadFuture
+{
+    Q_DISABLE_COPY_MOVE(QDownloadFuture)
+
+public:
+    using Result = QDownloader::Result;
+
+    // Use this instead of QFuture::result(), which is undefined for canceled
+    // futures as they have no result. Returns a result with the
+    // QDownloader::Error::Canceled error code for them, and waits for the
+    // future to finish otherwise.
+    static Result result(const QFuture<Result> &future);
+    // Finishes when all of the given futures have finished, the results keep
+    // the order of the given futures. Canceled downloads are reported with
+    // the QDownloader::Error::Canceled error code.
+    static QFuture<QList<Result>> whenAll(const QList<QFuture<Result>> &futures);
+    // Finishes with the result of the first finished future. The other
+    // downloads keep running, use cancelAll() to stop them.
+    static QFuture<Result> whenAny(const QList<QFuture<Result>> &futures);
+    static void cancelAll(const QList<QFuture<Result>> &futures);
+    // Calls the callback in the thread of the context object once the future
+    // has finished. Nothing will be called if the context object is destroyed
+    // before that.
+    static void then(const QFuture<Result> &future,
+                     QObject *context,
+                     const std::function<void(const Result &)> &callback);
+
+private:
+    QDownloadFuture() = default;
+    ~QDownloadFuture() = default;
+};
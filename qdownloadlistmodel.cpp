@@ -0,0 +1,371 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2020 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "qdownloadlistmodel.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QTimerEvent>
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+QDownloadListModel::Task currentTask(const QDownloader *downloader)
+{
+    Q_ASSERT(downloader);
+    QDownloadListModel::Task task = {};
+    task.url = downloader->url();
+    task.fileName = downloader->fileInfo().fileName;
+    task.fileSize = downloader->fileInfo().fileSize;
+    task.progress = downloader->progress();
+    task.speed = downloader->speed();
+    return task;
+}
+
+QDownloadListModel::Task finishedTask(const QDownloader *downloader)
+{
+    Q_ASSERT(downloader);
+    // The downloader has already reset its state, everything left is in the
+    // result. A failed result has no file, see mergeFinished().
+    const QDownloader::Result result = downloader->result();
+    QDownloadListModel::Task task = {};
+    task.url = result.url;
+    task.fileName = QFileInfo(result.filePath).fileName();
+    task.fileSize = result.fileSize;
+    if (result.error == QDownloader::Error::NoError) {
+        task.progress = 1.0;
+        task.state = QDownloadListModel::State::Finished;
+    } else {
+        task.state = QDownloadListModel::State::Failed;
+        task.errorString = result.errorString;
+    }
+    return task;
+}
+
+// Keeps what the finished task doesn't know (anymore) from the current row.
+void mergeFinished(QDownloadListModel::Task *target, const QDownloadListModel::Task &finished)
+{
+    Q_ASSERT(target);
+    target->state = finished.state;
+    target->errorString = finished.errorString;
+    target->speed = {};
+    if (finished.state == QDownloadListModel::State::Finished) {
+        target->progress = 1.0;
+    }
+    if (finished.url.isValid()) {
+        target->url = finished.url;
+    }
+    if (!finished.fileName.isEmpty()) {
+        target->fileName = finished.fileName;
+    }
+    if (finished.fileSize > 0) {
+        target->fileSize = finished.fileSize;
+    }
+}
+
+} // namespace
+
+QDownloadListModel::QDownloadListModel(QObject *parent)
+    : QAbstractListModel(parent), m_pending(QSharedPointer<Pending>::create())
+{
+    qRegisterMetaType<Task>();
+    m_pending->model = this;
+}
+
+QDownloadListModel::~QDownloadListModel()
+{
+    for (auto &&connections : qAsConst(m_connections)) {
+        for (auto &&connection : qAsConst(connections)) {
+            disconnect(connection);
+        }
+    }
+    {
+        // A notification which is running already finishes on the shared
+        // state and won't touch the model.
+        QMutexLocker locker(&m_pending->mutex);
+        m_pending->alive = false;
+    }
+    m_updateTimer.stop();
+}
+
+int QDownloadListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_tasks.size();
+}
+
+QVariant QDownloadListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || (index.row() < 0) || (index.row() >= m_tasks.size())) {
+        return {};
+    }
+    const Task &task = m_tasks.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+    case FileNameRole:
+        return task.fileName;
+    case UrlRole:
+        return task.url;
+    case FileSizeRole:
+        return task.fileSize;
+    case ProgressRole:
+        return task.progress;
+    case SpeedRole:
+        return QVariant::fromValue(task.speed);
+    case StateRole:
+        return QVariant::fromValue(task.state);
+    case ErrorStringRole:
+        return task.errorString;
+    default:
+        break;
+    }
+    return {};
+}
+
+QHash<int, QByteArray> QDownloadListModel::roleNames() const
+{
+    return {{UrlRole, "url"},
+            {FileNameRole, "fileName"},
+            {FileSizeRole, "fileSize"},
+            {ProgressRole, "progress"},
+            {SpeedRole, "speed"},
+            {StateRole, "state"},
+            {ErrorStringRole, "errorString"}};
+}
+
+QVector<QDownloadListModel::Task> QDownloadListModel::snapshot() const
+{
+    return m_tasks;
+}
+
+void QDownloadListModel::addDownloader(QDownloader *downloader)
+{
+    if (!downloader) {
+        qDebug() << "The given downloader is null.";
+        return;
+    }
+    if (m_downloaders.contains(downloader)) {
+        return;
+    }
+    const quint64 id = m_nextId++;
+    m_downloaders.insert(downloader, id);
+    const int row = m_tasks.size();
+    beginInsertRows({}, row, row);
+    // The downloader may live in another thread, so it must not be read here.
+    // Its first notification fills the row.
+    m_tasks.append(Task{});
+    m_ids.append(id);
+    m_rows.insert(id, row);
+    endInsertRows();
+    // Direct connections: the notifications are handled in the thread of the
+    // downloader and only record the new state, no event is posted per task.
+    const QSharedPointer<Pending> pending = m_pending;
+    const auto update = [pending, downloader, id]() {
+        record(pending.data(), id, currentTask(downloader), false);
+    };
+    const auto finish = [pending, downloader, id]() {
+        record(pending.data(), id, finishedTask(downloader), true);
+    };
+    QVector<QMetaObject::Connection> &connections = m_connections[id];
+    connections.append(
+        connect(downloader, &QDownloader::progressChanged, this, update, Qt::DirectConnection));
+    connections.append(
+        connect(downloader, &QDownloader::fileInfoChanged, this, update, Qt::DirectConnection));
+    connections.append(
+        connect(downloader, &QDownloader::urlChanged, this, update, Qt::DirectConnection));
+    connections.append(
+        connect(downloader, &QDownloader::finished, this, finish, Qt::DirectConnection));
+    connections.append(connect(downloader, &QObject::destroyed, this, [this, downloader, id]() {
+        // Connections of a destroyed object are gone already, and the pointer
+        // must not be touched anymore.
+        if (m_downloaders.value(downloader) == id) {
+            m_downloaders.remove(downloader);
+        }
+        m_connections.remove(id);
+        removeTask(id);
+    }));
+}
+
+void QDownloadListModel::removeDownloader(QDownloader *downloader)
+{
+    const auto it = m_downloaders.find(downloader);
+    if (it == m_downloaders.end()) {
+        return;
+    }
+    const quint64 id = it.value();
+    m_downloaders.erase(it);
+    const QVector<QMetaObject::Connection> connections = m_connections.take(id);
+    for (auto &&connection : qAsConst(connections)) {
+        disconnect(connection);
+    }
+    removeTask(id);
+}
+
+void QDownloadListModel::removeTask(quint64 id)
+{
+    if (!m_rows.contains(id)) {
+        return;
+    }
+    {
+        QMutexLocker locker(&m_pending->mutex);
+        m_pending->updates.remove(id);
+    }
+    // Removing rows one by one renumbers everything behind them each time,
+    // which is quadratic when thousands of tasks go away at once.
+    m_removed.insert(id);
+    startUpdates();
+}
+
+void QDownloadListModel::removePendingRows()
+{
+    if (m_removed.isEmpty()) {
+        return;
+    }
+    QVector<int> rows = {};
+    rows.reserve(m_removed.size());
+    for (auto &&id : qAsConst(m_removed)) {
+        rows.append(m_rows.value(id));
+    }
+    m_removed.clear();
+    // From the back, so that the rows in front stay valid.
+    std::sort(rows.begin(), rows.end(), std::greater<int>());
+    int last = 0;
+    for (int i = 1; i <= rows.size(); ++i) {
+        if ((i == rows.size()) || (rows.at(i) != (rows.at(i - 1) - 1))) {
+            const int first = rows.at(i - 1);
+            const int count = rows.at(last) - first + 1;
+            beginRemoveRows({}, first, rows.at(last));
+            m_tasks.remove(first, count);
+            m_ids.remove(first, count);
+            endRemoveRows();
+            last = i;
+        }
+    }
+    m_rows.clear();
+    m_rows.reserve(m_ids.size());
+    for (int i = 0; i != m_ids.size(); ++i) {
+        m_rows.insert(m_ids.at(i), i);
+    }
+}
+
+void QDownloadListModel::startUpdates()
+{
+    if (!m_updateTimer.isActive()) {
+        m_updateTimer.start(m_updateInterval, this);
+    }
+}
+
+int QDownloadListModel::updateInterval() const
+{
+    return m_updateInterval;
+}
+
+void QDownloadListModel::setUpdateInterval(int value)
+{
+    if (value < 1) {
+        qDebug() << "The minimum of update interval is one.";
+        return;
+    }
+    if (m_updateInterval != value) {
+        m_updateInterval = value;
+        if (m_updateTimer.isActive()) {
+            m_updateTimer.start(m_updateInterval, this);
+        }
+        Q_EMIT updateIntervalChanged();
+    }
+}
+
+void QDownloadListModel::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_updateTimer.timerId()) {
+        publish();
+        return;
+    }
+    QAbstractListModel::timerEvent(event);
+}
+
+void QDownloadListModel::record(Pending *pending, quint64 id, const Task &task, bool finished)
+{
+    Q_ASSERT(pending);
+    QMutexLocker locker(&pending->mutex);
+    if (!pending->alive) {
+        return;
+    }
+    // Only the latest state of a task matters.
+    const auto it = pending->updates.find(id);
+    if (finished && (it != pending->updates.end())) {
+        mergeFinished(&it.value().task, task);
+        return;
+    }
+    pending->updates.insert(id, {task, finished});
+    if (!pending->scheduled) {
+        // Posted while the model is alive, the event is dropped if the model
+        // is destroyed before it's delivered.
+        pending->scheduled = true;
+        QDownloadListModel *model = pending->model;
+        QMetaObject::invokeMethod(
+            model, [model]() { model->startUpdates(); }, Qt::QueuedConnection);
+    }
+}
+
+void QDownloadListModel::publish()
+{
+    removePendingRows();
+    QHash<quint64, Update> pending = {};
+    {
+        QMutexLocker locker(&m_pending->mutex);
+        pending.swap(m_pending->updates);
+        if (pending.isEmpty()) {
+            // Idle until the next record() or removeTask(), the removed rows
+            // are gone already.
+            m_pending->scheduled = false;
+            m_updateTimer.stop();
+            return;
+        }
+    }
+    QVector<int> rows = {};
+    rows.reserve(pending.size());
+    for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+        const auto row = m_rows.constFind(it.key());
+        if (row == m_rows.cend()) {
+            continue;
+        }
+        const Update &update = it.value();
+        if (update.finished) {
+            mergeFinished(&m_tasks[row.value()], update.task);
+        } else {
+            m_tasks[row.value()] = update.task;
+        }
+        rows.append(row.value());
+    }
+    std::sort(rows.begin(), rows.end());
+    // One dataChanged() per contiguous range of changed rows.
+    int first = 0;
+    for (int i = 1; i <= rows.size(); ++i) {
+        if ((i == rows.size()) || (rows.at(i) != (rows.at(i - 1) + 1))) {
+            Q_EMIT dataChanged(index(rows.at(first)), index(rows.at(i - 1)));
+            first = i;
+        }
+    }
+}
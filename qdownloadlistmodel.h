@@ -0,0 +1,142 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2020 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "qdownloader.h"
+#include <QAbstractListModel>
+#include <QBasicTimer>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QVector>
+
+#define _WWX190_DL_DEFAULT_MODEL_UPDATE_INTERVAL 33
+
+// A list model over many downloaders. The downloaders may live in other
+// threads: their notifications only record the new state, which is published
+// to the model in coalesced dataChanged() ranges every update interval.
+class QDOWNLOADER_EXPORT QDownloadListModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(QDownloadListModel)
+    Q_PROPERTY(int updateInterval READ updateInterval WRITE setUpdateInterval NOTIFY
+                   updateIntervalChanged)
+
+public:
+    enum class State { Downloading, Finished, Failed };
+    Q_ENUM(State)
+
+    struct Task
+    {
+        QUrl url = {};
+        QString fileName = {};
+        qint64 fileSize = 0;
+        qreal progress = 0.0;
+        QDownloader::Speed speed = {};
+        State state = State::Downloading;
+        QString errorString = {};
+    };
+
+    enum Roles {
+        UrlRole = Qt::UserRole + 1,
+        FileNameRole,
+        FileSizeRole,
+        ProgressRole,
+        SpeedRole,
+        StateRole,
+        ErrorStringRole
+    };
+    Q_ENUM(Roles)
+
+    explicit QDownloadListModel(QObject *parent = nullptr);
+    ~QDownloadListModel() override;
+
+    int rowCount(const QModelIndex &parent = {}) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // Implicitly shared, so taking a snapshot of all tasks is cheap and needs
+    // no locking. Must be called from the thread of the model.
+    QVector<Task> snapshot() const;
+
+public Q_SLOTS:
+    void addDownloader(QDownloader *downloader);
+    // The row goes away with the next update, together with all other
+    // removed rows.
+    void removeDownloader(QDownloader *downloader);
+
+    int updateInterval() const;
+    void setUpdateInterval(int value = _WWX190_DL_DEFAULT_MODEL_UPDATE_INTERVAL);
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    void removeTask(quint64 id);
+    void removePendingRows();
+    void startUpdates();
+    void publish();
+
+Q_SIGNALS:
+    void updateIntervalChanged();
+
+private:
+    struct Update
+    {
+        Task task = {};
+        bool finished = false; // Only the state, error and progress are known.
+    };
+
+    // Written by the threads of the downloaders, taken by publish(). Shared
+    // with the notifications, which may still be running when the model is
+    // destroyed.
+    struct Pending
+    {
+        QMutex mutex;
+        QHash<quint64, Update> updates = {};
+        bool alive = true; // False once the model is being destroyed.
+        // The timer is stopped while nothing changes, the first update
+        // starts it again.
+        bool scheduled = false;
+        QDownloadListModel *model = nullptr;
+    };
+
+    static void record(Pending *pending, quint64 id, const Task &task, bool finished);
+
+    QVector<Task> m_tasks = {};
+    QVector<quint64> m_ids = {};
+    QHash<quint64, int> m_rows = {};
+    QSet<quint64> m_removed = {};
+    QHash<QDownloader *, quint64> m_downloaders = {};
+    // Handles stay safe to disconnect after the downloader is gone.
+    QHash<quint64, QVector<QMetaObject::Connection>> m_connections = {};
+    quint64 m_nextId = 0;
+    QSharedPointer<Pending> m_pending = {};
+    QBasicTimer m_updateTimer = {};
+    int m_updateInterval = _WWX190_DL_DEFAULT_MODEL_UPDATE_INTERVAL;
+};
+
+Q_DECLARE_METATYPE(QDownloadListModel::Task)
@@ -0,0 +1,182 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2020 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "qdownloadpostprocessor.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QRunnable>
+
+class QDownloadPostProcessor::Job : public QRunnable
+{
+public:
+    explicit Job(QDownloadPostProcessor *processor,
+                 QDownloader *downloader,
+                 quint64 serial,
+                 const QDownloader::Result &result,
+                 const QList<QDownloader::PostProcessHook> &hooks)
+        : m_processor(processor)
+        , m_downloader(downloader)
+        , m_serial(serial)
+        , m_result(result)
+        , m_hooks(hooks)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        // Everything the downloader is told goes through the thread of the
+        // processor, which outlives the job. A hook may keep the callback
+        // beyond the job, so it captures nothing of the job itself.
+        QDownloadPostProcessor *processor = m_processor;
+        const QPointer<QDownloader> downloader = m_downloader;
+        const auto status = [processor, downloader](const QString &value) {
+            QMetaObject::invokeMethod(
+                processor,
+                [downloader, value]() {
+                    if (downloader) {
+                        Q_EMIT downloader->postProcessStatusChanged(value);
+                    }
+                },
+                Qt::QueuedConnection);
+        };
+        QElapsedTimer timer;
+        timer.start();
+        bool ok = true;
+        QString errorString = {};
+        for (auto &&hook : qAsConst(m_hooks)) {
+            if (hook && !hook(m_result, status, &errorString)) {
+                ok = false;
+                break;
+            }
+        }
+        const qint64 elapsed = timer.elapsed();
+        const quint64 serial = m_serial;
+        QMetaObject::invokeMethod(
+            processor,
+            [processor, downloader, serial, ok, errorString, elapsed]() {
+                processor->onJobFinished(downloader, serial, ok, errorString, elapsed);
+            },
+            Qt::QueuedConnection);
+    }
+
+private:
+    QDownloadPostProcessor *m_processor = nullptr;
+    QPointer<QDownloader> m_downloader = nullptr;
+    quint64 m_serial = 0;
+    QDownloader::Result m_result = {};
+    QList<QDownloader::PostProcessHook> m_hooks = {};
+};
+
+QDownloadPostProcessor::QDownloadPostProcessor(QObject *parent) : QObject(parent) {}
+
+QDownloadPostProcessor::~QDownloadPostProcessor()
+{
+    m_pool.waitForDone();
+    // The jobs have queued their completion to this object, deliver it before
+    // the posted events are dropped, or the downloaders would never finish.
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+}
+
+int QDownloadPostProcessor::maxThreadCount() const
+{
+    return m_pool.maxThreadCount();
+}
+
+void QDownloadPostProcessor::setMaxThreadCount(int value)
+{
+    if (value < 1) {
+        qDebug() << "The minimum of thread count is one.";
+        return;
+    }
+    if (m_pool.maxThreadCount() != value) {
+        m_pool.setMaxThreadCount(value);
+        Q_EMIT maxThreadCountChanged();
+    }
+}
+
+int QDownloadPostProcessor::maxPendingJobs() const
+{
+    return m_maxPendingJobs;
+}
+
+void QDownloadPostProcessor::setMaxPendingJobs(int value)
+{
+    if (value < 1) {
+        qDebug() << "The minimum of pending jobs is one.";
+        return;
+    }
+    if (m_maxPendingJobs != value) {
+        const bool wasSaturated = isSaturated();
+        m_maxPendingJobs = value;
+        Q_EMIT maxPendingJobsChanged();
+        if (isSaturated() != wasSaturated) {
+            Q_EMIT saturatedChanged();
+        }
+    }
+}
+
+int QDownloadPostProcessor::pendingJobs() const
+{
+    return m_pendingJobs;
+}
+
+bool QDownloadPostProcessor::isSaturated() const
+{
+    return m_pendingJobs >= m_maxPendingJobs;
+}
+
+void QDownloadPostProcessor::submit(QDownloader *downloader,
+                                    quint64 serial,
+                                    const QDownloader::Result &result,
+                                    const QList<QDownloader::PostProcessHook> &hooks)
+{
+    Q_ASSERT(downloader);
+    const bool wasSaturated = isSaturated();
+    ++m_pendingJobs;
+    m_pool.start(new Job(this, downloader, serial, result, hooks));
+    Q_EMIT pendingJobsChanged();
+    if (isSaturated() != wasSaturated) {
+        Q_EMIT saturatedChanged();
+    }
+}
+
+void QDownloadPostProcessor::onJobFinished(const QPointer<QDownloader> &downloader,
+                                           quint64 serial,
+                                           bool ok,
+                                           const QString &errorString,
+                                           qint64 elapsed)
+{
+    const bool wasSaturated = isSaturated();
+    --m_pendingJobs;
+    Q_EMIT pendingJobsChanged();
+    if (isSaturated() != wasSaturated) {
+        Q_EMIT saturatedChanged();
+    }
+    if (downloader) {
+        downloader->finishPostProcess(serial, ok, errorString, elapsed);
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2020 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "qdownloader.h"
+#include <QThreadPool>
+
+#define _WWX190_DL_DEFAULT_POST_PROCESS_PENDING_JOBS 16
+
+// Runs the post process hooks of downloaders on its own thread pool, so that
+// verifying, extracting or indexing files overlaps with further transfers.
+// Must live in the same thread as the downloaders using it.
+class QDOWNLOADER_EXPORT QDownloadPostProcessor : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(QDownloadPostProcessor)
+    Q_PROPERTY(int maxThreadCount READ maxThreadCount WRITE setMaxThreadCount NOTIFY
+                   maxThreadCountChanged)
+    Q_PROPERTY(int maxPendingJobs READ maxPendingJobs WRITE setMaxPendingJobs NOTIFY
+                   maxPendingJobsChanged)
+    Q_PROPERTY(int pendingJobs READ pendingJobs NOTIFY pendingJobsChanged)
+    Q_PROPERTY(bool saturated READ isSaturated NOTIFY saturatedChanged)
+
+public:
+    explicit QDownloadPostProcessor(QObject *parent = nullptr);
+    // Waits for all submitted jobs.
+    ~QDownloadPostProcessor() override;
+
+public Q_SLOTS:
+    int maxThreadCount() const;
+    void setMaxThreadCount(int value);
+
+    // Download queues should hold back new transfers while the number of
+    // queued and running jobs reaches this limit.
+    int maxPendingJobs() const;
+    void setMaxPendingJobs(int value = _WWX190_DL_DEFAULT_POST_PROCESS_PENDING_JOBS);
+
+    int pendingJobs() const;
+    bool isSaturated() const;
+
+private:
+    class Job;
+
+    void submit(QDownloader *downloader,
+                quint64 serial,
+                const QDownloader::Result &result,
+                const QList<QDownloader::PostProcessHook> &hooks);
+    void onJobFinished(const QPointer<QDownloader> &downloader,
+                       quint64 serial,
+                       bool ok,
+                       const QString &errorString,
+                       qint64 elapsed);
+
+Q_SIGNALS:
+    void maxThreadCountChanged();
+    void maxPendingJobsChanged();
+    void pendingJobsChanged();
+    void saturatedChanged();
+
+private:
+    QThreadPool m_pool;
+    int m_maxPendingJobs = _WWX190_DL_DEFAULT_POST_PROCESS_PENDING_JOBS, m_pendingJobs = 0;
+
+    friend class QDownloader;
+};